@@ -28,6 +28,8 @@
 #define ALGORITHM_EXT_H
 
 #include <algorithm>
+#include <omp.h>
+#include <vector>
 
 namespace alg {
 
@@ -38,6 +40,24 @@ bool equal(FIterator1 first1, FIterator1 last1, FIterator2 first2, FIterator2 la
 	return std::equal(first1, last1, first2);
 }
 
+// Non-owning view on a contiguous array, e.g. a vector or a mapped file.
+template<typename T>
+struct array_view
+{
+	const T *first = nullptr, *last = nullptr;
+	
+	array_view() {}
+	array_view(const T *first, std::size_t size) : first(first), last(first + size) {}
+	array_view(const std::vector<T> &v) : first(v.data()), last(v.data() + v.size()) {}
+	
+	const T *begin() const { return first; }
+	const T *end() const { return last; }
+	const T *data() const { return first; }
+	std::size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	const T &operator[](std::size_t i) const { return first[i]; }
+};
+
 template<typename FIterator, typename BinaryPredicate>
 bool adjacent_range(FIterator &first, FIterator &second, FIterator last, BinaryPredicate p)
 {
@@ -71,6 +91,38 @@ void process_adjacent(FIterator first, FIterator last, BP p, A1 not_p, A2 are_p)
 	}
 }
 
+// Like process_adjacent(), on all cores. The range is cut into chunks only
+// between elements that don't satisfy p, so a range of not_p may come in
+// parts, but a range of are_p never does. The callbacks of a chunk get its
+// own Output as first argument, join() gets the outputs in order.
+template<typename Output, typename RIterator, typename BP, typename A1, typename A2, typename Join>
+void parallel_process_adjacent(RIterator first, RIterator last, BP p, A1 not_p, A2 are_p, Join join)
+{
+	const std::ptrdiff_t grain = 1 << 14;
+	std::ptrdiff_t n = last - first;
+	int chunks = std::max(std::min(std::ptrdiff_t(4 * omp_get_max_threads()), n / grain), std::ptrdiff_t(1));
+	
+	std::vector<RIterator> cuts(chunks + 1, first);
+	cuts[chunks] = last;
+	for (int c = 1; c < chunks; ++c) {
+		RIterator &cut = cuts[c];
+		for (cut = std::max(first + n * c / chunks, cuts[c - 1]); cut != last && p(cut[-1], *cut); ++cut);
+	}
+	
+	std::vector<Output> outputs(chunks);
+	#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunks; ++c) {
+		Output &output = outputs[c];
+		process_adjacent(cuts[c], cuts[c + 1], p,
+			[&] (RIterator a, RIterator b) { not_p(output, a, b); },
+			[&] (RIterator a, RIterator b) { are_p(output, a, b); }
+		);
+	}
+	
+	for (Output &output : outputs)
+		join(output);
+}
+
 };
 
 #endif // ALGORITHM_EXT_H
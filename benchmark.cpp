@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Benchmarks CloneGrid on a source tree, usually one made by the generator:
+//
+//   clonegrid_bench generate <dir> [--files=N] [--lines=N] [--density=F]
+//                                  [--group=N] [--fragment=N] [--seed=N]
+//   clonegrid_bench run <dir> [--repeat=N] [--normalize=whitespace|tokens]
+//   clonegrid_bench check <dir> [--check=near|normalize|far] [generate options]
+//
+// Each stage is timed on its own, as the best of the repeats, followed by
+// the whole headless analysis of the tree. The checks run all, or the one
+// asked for, and fail on a wrong result; near generates a tree in <dir>.
+
+#include "clone_grid.h"
+#include "corpus.h"
+#include "file_index.h"
+#include "generator.h"
+#include "hash_detector.h"
+#include "near_detector.h"
+#include "sort_detector.h"
+#include "spatial_index.h"
+#include "stream_detector.h"
+#include "suffix_detector.h"
+
+#include <boost/format.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <parallel/algorithm>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double> seconds;
+typedef std::pair<int, int> IPoint;
+
+static const int s_runs = 4;
+static const int s_pairs = CloneGrid::s_pairs; // Bigger groups are clone classes
+
+// CloneGrid reports on std::cout, which is not what is measured.
+class Quiet
+{
+public:
+	Quiet() : m_out(std::cout.rdbuf(nullptr)) {}
+	~Quiet() { std::cout.rdbuf(m_out); std::cout.clear(); }
+	
+private:
+	std::streambuf *m_out;
+};
+
+// Best time of run(), with setup() before every repeat and not timed.
+template<typename Setup, typename Run>
+static double measure(int repeat, Setup setup, Run run)
+{
+	double best = 0;
+	for (int i = 0; i < repeat; ++i) {
+		setup();
+		Clock::time_point t0 = Clock::now();
+		run();
+		double t = seconds(Clock::now() - t0).count();
+		if (i == 0 || t < best) best = t;
+	}
+	return best;
+}
+
+static void print(const char *name, double t, std::uint64_t bytes, std::size_t lines)
+{
+	std::cout << boost::format("%-12s %10.3f ms %10.1f MiB/s %12.0f LOC/s\n")
+		% name % (t * 1e3) % (bytes / 1024. / 1024. / t) % (lines / t);
+}
+
+static void run(const boost::filesystem::path &root, int repeat, Normalize normalize)
+{
+	// The whole analysis first, it also finds the files for the stages.
+	std::unique_ptr<CloneGrid> grid;
+	double total = measure(repeat, [&] {
+		grid.reset(new CloneGrid(s_runs));
+		grid->set_normalize(normalize);
+		grid->read_source(root);
+	}, [&] {
+		Quiet quiet;
+		grid->finalize();
+	});
+	
+	const CloneGrid::Files &files = grid->files();
+	std::uint64_t bytes = grid->bytes();
+	std::size_t size = grid->size();
+	std::cout << boost::format("Corpus:      %.3f MiB, %d LOC, %d files\n\n")
+		% (bytes / 1024. / 1024.) % size % files.size();
+	
+	Corpus corpus;
+	print("read", measure(repeat, [] {}, [&] { corpus.read(files, normalize); }), bytes, size);
+	print("hash", measure(repeat, [&] { corpus.read(files, normalize); }, [&] { corpus.hash(s_runs); }), bytes, size);
+	
+	IDetector::Lines windows, lines;
+	for (SourceFile *file : files)
+		for (int i = 0; i <= int(file->line_count()) - s_runs; ++i)
+			windows.push_back(file->m_position + i);
+	
+	// The points of all pairs of clones above the diagonal, as CloneGrid
+	// pairs them up.
+	std::vector<IPoint> points;
+	auto pairs = [&] (IDetector::Lines::iterator first, IDetector::Lines::iterator last) {
+		if (last + 1 - first >= s_pairs) return; // Clone classes instead
+		for (auto i1 = first; i1 <= last; ++i1)
+		for (auto i2 = i1 + 1; i2 <= last; ++i2) {
+			int x = std::min(*i1, *i2), y = std::max(*i1, *i2);
+			points.emplace_back(x - y, y);
+		}
+	};
+	std::size_t groups = 0;
+	auto count = [&] (IDetector::Lines::iterator, IDetector::Lines::iterator) { groups++; };
+	
+	HashDetector hash;
+	SortDetector sort;
+	SuffixDetector suffix;
+	NearDetector near;
+	print("hash engine", measure(repeat, [&] { lines = windows; groups = 0; }, [&] { hash.detect(corpus, lines, s_runs, count); }), bytes, size);
+	print("sort engine", measure(repeat, [&] { lines = windows; groups = 0; }, [&] { sort.detect(corpus, lines, s_runs, count); }), bytes, size);
+	print("suffix array", measure(repeat, [&] { lines = windows; groups = 0; }, [&] { suffix.detect(corpus, lines, s_runs, count); }), bytes, size);
+	print("near-miss", measure(repeat, [&] { lines = windows; groups = 0; }, [&] {
+		near.detect_runs(corpus, lines, s_runs, s_pairs, count, [] (std::uint32_t, std::uint32_t, std::uint32_t) {});
+	}), bytes, size);
+	
+	// Reading included, the windows sorted on disk within 64 MiB.
+	print("stream", measure(repeat, [&] { groups = 0; }, [&] {
+		StreamDetector stream(64 << 20);
+		stream.read(files, normalize, s_runs);
+		stream.detect(count);
+	}), bytes, size);
+	
+	lines = windows;
+	hash.detect(corpus, lines, s_runs, pairs);
+	std::vector<IPoint> sorted;
+	print("sort pairs", measure(repeat, [&] { sorted = points; }, [&] {
+		__gnu_parallel::sort(begin(sorted), end(sorted));
+	}), bytes, size);
+	
+	// Runs of aligned points become lines, as in CloneGrid::find_runs().
+	std::size_t runs = 0;
+	print("find runs", measure(repeat, [&] { runs = 0; }, [&] {
+		alg::parallel_process_adjacent<std::size_t>(begin(sorted), end(sorted),
+			[] (const IPoint &a, const IPoint &b) { return a.first == b.first && a.second + 1 == b.second; },
+			[] (std::size_t &n, std::vector<IPoint>::iterator first, std::vector<IPoint>::iterator last) { n += ++last - first; },
+			[] (std::size_t &n, std::vector<IPoint>::iterator, std::vector<IPoint>::iterator) { n++; },
+			[&] (std::size_t n) { runs += n; }
+		);
+	}), bytes, size);
+	
+	const int lookups = 1 << 20;
+	std::mt19937 engine(1);
+	std::vector<int> positions(lookups);
+	for (int &position : positions)
+		position = engine() % std::max(size, std::size_t(1));
+	std::size_t found = 0;
+	double t = measure(repeat, [&] { found = 0; }, [&] {
+		for (int position : positions)
+			found += grid->get_file(position) != nullptr;
+	});
+	std::cout << boost::format("%-12s %10.3f ms %10.1f M lookups/s\n") % "get_file" % (t * 1e3) % (lookups / t / 1e6);
+	
+	std::cout << "\n";
+	print("total", total, bytes, size);
+	std::cout << boost::format("Found:       %d groups, %d pairs, %d points and lines\n")
+		% groups % points.size() % runs;
+}
+
+// Quotes left open must not make the normalized text outgrow its slack,
+// e.g. every line of """ in Python.
+static bool check_normalize()
+{
+	std::string text;
+	for (int i = 0; i < 2000; ++i)
+		text += "\"\"\"\n\"\n'\n\"\\\n \" \" \"\n";
+	text += "\"";
+	
+	bool ok = true;
+	std::size_t most = 0;
+	for (Normalize normalize : {Normalize::whitespace, Normalize::tokens}) {
+		const std::size_t size = text.size() + Corpus::s_slack, guard = 64;
+		std::vector<char> out(size + guard, '#');
+		std::size_t n = Corpus::normalize(text.data(), text.size(), out.data(), normalize);
+		ok &= n <= size && std::count(out.begin() + size, out.end(), '#') == std::ptrdiff_t(guard);
+		most = std::max(most, n);
+	}
+	std::cout << boost::format("Normalize:   %d bytes to at most %d, slack %d: %s\n")
+		% text.size() % most % Corpus::s_slack % (ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Clones far into a big repository keep their exact lines: past 2^24 a float
+// no longer holds every line, up to 2^30 positions still align, locate and
+// upload exactly, relative to the origin of their block.
+static bool check_far()
+{
+	const int firsts[] = {0, (1 << 24) - 300, (1 << 24) + 400, (1 << 28) + 5, (1 << 30) + 12345};
+	const int files = 5, size = (1 << 30) + 20000, length = 300;
+	std::deque<SourceFile> sources;
+	FileIndex::Files index_files;
+	for (int f = 0; f < files; ++f) {
+		sources.emplace_back("far" + std::to_string(f), 0, firsts[f]);
+		sources.back().m_count = (f + 1 < files ? firsts[f + 1] : size) - firsts[f];
+		index_files.push_back(&sources.back());
+	}
+	FileIndex index;
+	index.build(index_files, size);
+	
+	// A run from every file to every later one, as CloneGrid keeps it.
+	bool ok = true;
+	std::size_t pairs = 0;
+	int last = 0;
+	std::vector<SpatialIndex::Point> points;
+	std::vector<SpatialIndex::Line> lines;
+	for (int a = 0; a < files; ++a)
+	for (int b = a + 1; b < files; ++b) {
+		IPoint first(firsts[a] + 3 + a, firsts[b] + 250 - b), previous;
+		for (int i = 0; i < length; ++i, ++pairs) {
+			IPoint p(first.first + i, first.second + i), q = CloneGrid::align(p);
+			FileIndex::Location x = index.locate(p.first), y = index.locate(p.second);
+			ok &= CloneGrid::reset(q) == p && (i == 0 || CloneGrid::aligned(previous, q));
+			ok &= x.file == index_files[a] && x.line == 3 + a + i && y.file == index_files[b] && y.line == 250 - b + i;
+			points.push_back(p);
+			last = std::max(last, p.second);
+			previous = q;
+		}
+		lines.emplace_back(first, IPoint(first.first + length - 1, first.second + length - 1));
+	}
+	
+	// Lines are cut at tiles, every piece ends where the next one starts.
+	SpatialIndex::arrange(points, lines);
+	std::vector<SpatialIndex::Vertex> vertices = SpatialIndex::vertices(points);
+	std::vector<SpatialIndex::Run> runs = SpatialIndex::runs(lines);
+	std::int64_t covered = 0;
+	for (std::size_t i = 0; i < points.size(); ++i) {
+		SpatialIndex::Point o = SpatialIndex::origin(points[i]);
+		ok &= o.first + double(vertices[i].first) == points[i].first && o.second + double(vertices[i].second) == points[i].second;
+	}
+	for (std::size_t i = 0; i < lines.size(); ++i) {
+		SpatialIndex::Point o = SpatialIndex::origin(lines[i].first);
+		std::int64_t n = runs[i].first >> 20;
+		ok &= o.first + (runs[i].first & ((1 << 20) - 1)) == lines[i].first.first && o.second + runs[i].second == lines[i].first.second;
+		ok &= lines[i].second.first == lines[i].first.first + n && lines[i].second.second == lines[i].first.second + n;
+		covered += n;
+	}
+	ok &= covered == std::int64_t(pairs - pairs / length);
+	
+	// Queries at a far point find it in a block that puts it back exactly.
+	SpatialIndex spatial;
+	spatial.build(points, lines);
+	std::vector<int> first, count;
+	std::vector<SpatialIndex::Batch> batches;
+	for (std::size_t i = 0; i < points.size(); i += 97) {
+		spatial.points(points[i].first - .5, points[i].second - .5, points[i].first + .5, points[i].second + .5, first, count, batches);
+		bool found = false;
+		for (std::size_t b = 0, r = 0; b < batches.size(); r = batches[b++].end)
+			for (; r < batches[b].end; ++r)
+				for (int k = first[r]; k < first[r] + count[r]; ++k)
+					found |= batches[b].origin.first + double(vertices[k].first) == points[i].first &&
+						batches[b].origin.second + double(vertices[k].second) == points[i].second;
+		ok &= found;
+	}
+	
+	std::cout << boost::format("Far:         %d pairs up to line %d: %s\n")
+		% pairs % last % (ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// The generated fragments are copied without edits, so the near-miss engine
+// pairs up exactly what the hash engine does, also with clone classes.
+static bool check_near(const boost::filesystem::path &root, Generator generator)
+{
+	generator.m_group = std::max(generator.m_group, 2 * s_pairs);
+	generator.write(root);
+	
+	CloneGrid grid(s_runs);
+	grid.read_source(root);
+	{
+		Quiet quiet;
+		grid.finalize();
+	}
+	Corpus corpus;
+	corpus.read(grid.files(), Normalize::none);
+	IDetector::Lines windows, lines;
+	for (SourceFile *file : grid.files())
+		for (int i = 0; i <= int(file->line_count()) - s_runs; ++i)
+			windows.push_back(file->m_position + i);
+	
+	std::size_t classes = 0, exact = 0, near = 0;
+	lines = windows;
+	HashDetector().detect(corpus, lines, s_runs, [&] (IDetector::Lines::iterator first, IDetector::Lines::iterator last) {
+		std::size_t n = last + 1 - first;
+		if (n >= std::size_t(s_pairs)) classes++;
+		else exact += n * (n - 1) / 2;
+	});
+	lines = windows;
+	NearDetector().detect_runs(corpus, lines, s_runs, s_pairs, [] (IDetector::Lines::iterator, IDetector::Lines::iterator) {},
+		[&] (std::uint32_t, std::uint32_t, std::uint32_t length) { near += length; });
+	
+	bool ok = classes > 0 && near == exact;
+	std::cout << boost::format("Near-miss:   %d classes, %d pairs hash, %d pairs near: %s\n")
+		% classes % exact % near % (ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static void usage(const char *name)
+{
+	std::cout << "Usage: " << name << " generate <dir> [--files=N] [--lines=N] [--density=F]"
+		" [--group=N] [--fragment=N] [--seed=N]\n"
+		"       " << name << " run <dir> [--repeat=N] [--normalize=whitespace|tokens]\n"
+		"       " << name << " check <dir> [--check=near|normalize|far] [generate options]\n";
+}
+
+// A whole number from 1 to most, or 0 when the value is anything else.
+static std::uint64_t count(const std::string &value, std::uint64_t most)
+{
+	if (value.empty() || value.size() > 18 || value.find_first_not_of("0123456789") != std::string::npos)
+		return 0;
+	std::uint64_t n = std::stoull(value);
+	return n <= most ? n : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		usage(argv[0]);
+		return 0;
+	}
+	
+	std::string command(argv[1]);
+	Generator generator;
+	int repeat = 3;
+	Normalize normalize = Normalize::none;
+	std::string only;
+	auto invalid = [&] (const std::string &arg) {
+		std::cerr << "Invalid value: " << arg << "\n";
+		usage(argv[0]);
+		return 1;
+	};
+	for (int i = 3; i < argc; i++) {
+		std::string arg(argv[i]);
+		std::size_t eq = arg.find('=');
+		std::string name = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+		std::uint64_t n = 0;
+		if (name == "--files") {
+			if (!(n = count(value, 1 << 20))) return invalid(arg);
+			generator.m_files = n;
+		}
+		else if (name == "--lines") {
+			if (!(n = count(value, 1 << 20))) return invalid(arg);
+			generator.m_lines = n;
+		}
+		else if (name == "--density") {
+			// A share, as digits with at most one point.
+			std::size_t point = value.find('.');
+			std::string digits = point == std::string::npos ? value : value.substr(0, point) + value.substr(point + 1);
+			if (digits.empty() || digits.size() > 18 || digits.find_first_not_of("0123456789") != std::string::npos)
+				return invalid(arg);
+			generator.m_density = std::stod("0" + value);
+			if (generator.m_density > 1) return invalid(arg);
+		}
+		else if (name == "--group") {
+			if ((n = count(value, 1 << 16)) < 2) return invalid(arg);
+			generator.m_group = n;
+		}
+		else if (name == "--fragment") {
+			if (!(n = count(value, 1 << 16))) return invalid(arg);
+			generator.m_fragment = n;
+		}
+		else if (name == "--seed") {
+			if (value != "0" && !(n = count(value, UINT32_MAX))) return invalid(arg);
+			generator.m_seed = n;
+		}
+		else if (name == "--repeat") {
+			if (!(n = count(value, 1 << 10))) return invalid(arg);
+			repeat = n;
+		}
+		else if (arg == "--normalize=whitespace")
+			normalize = Normalize::whitespace;
+		else if (arg == "--normalize=tokens")
+			normalize = Normalize::tokens;
+		else if (name == "--check")
+			only = value;
+		else
+			std::cerr << "Unknown option: " << arg << "\n";
+	}
+	
+	if (command == "generate")
+		generator.write(argv[2]);
+	else if (command == "run")
+		run(argv[2], repeat, normalize);
+	else if (command == "check") {
+		bool ok = true;
+		if (only.empty() || only == "normalize") ok &= check_normalize();
+		if (only.empty() || only == "near") ok &= check_near(argv[2], generator);
+		if (only.empty() || only == "far") ok &= check_far();
+		return ok ? 0 : 1;
+	}
+	else
+		std::cerr << "Unknown command: " << command << "\n";
+	
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clone_classes.h"
+
+#include <algorithm>
+
+void CloneClasses::clear()
+{
+	m_classes.clear();
+	m_members.clear();
+	m_groups.clear();
+}
+
+void CloneClasses::add_group(std::vector<int> members)
+{
+	std::sort(begin(members), end(members));
+	m_groups.push_back(std::move(members));
+}
+
+void CloneClasses::build()
+{
+	m_classes.clear();
+	m_members.clear();
+	std::sort(begin(m_groups), end(m_groups));
+	
+	// Group of every window that is a member of one.
+	std::vector<std::pair<int, std::size_t>> group;
+	for (std::size_t g = 0; g < m_groups.size(); ++g)
+		for (int p : m_groups[g])
+			group.emplace_back(p, g);
+	std::sort(begin(group), end(group));
+	
+	auto find = [&] (int p) -> const std::vector<int> * {
+		auto it = std::lower_bound(begin(group), end(group), std::make_pair(p, std::size_t(0)));
+		return it != end(group) && it->first == p ? &m_groups[it->second] : nullptr;
+	};
+	
+	// Whether all members of a move on to b.
+	auto follows = [] (const std::vector<int> *a, const std::vector<int> *b) {
+		if (!a || !b || a->size() != b->size()) return false;
+		for (std::size_t i = 0; i < a->size(); ++i)
+			if ((*a)[i] + 1 != (*b)[i]) return false;
+		return true;
+	};
+	
+	for (const std::vector<int> &g : m_groups) {
+		if (follows(find(g.front() - 1), &g)) continue;
+		
+		int length = 1;
+		for (const std::vector<int> *it = &g, *next; follows(it, next = find(it->front() + 1)); it = next)
+			++length;
+		
+		m_classes.push_back(Class{m_members.size(), std::uint32_t(g.size()), length});
+		m_members.insert(end(m_members), begin(g), end(g));
+	}
+	
+	m_groups.clear();
+}
+
+void CloneClasses::assign(alg::array_view<Class> classes, alg::array_view<std::int32_t> members)
+{
+	m_classes.assign(classes.begin(), classes.end());
+	m_members.assign(members.begin(), members.end());
+	m_groups.clear();
+}
+
+void CloneClasses::visible(double x0, double y0, double x1, double y1,
+	std::vector<Point> &points, std::vector<Line> &lines) const
+{
+	points.clear();
+	lines.clear();
+	
+	for (const Class &c : m_classes) {
+		alg::array_view<std::int32_t> m = members(c);
+		int n = c.length - 1;
+		auto xa = std::lower_bound(m.begin(), m.end(), x0 - n), xb = std::upper_bound(xa, m.end(), x1);
+		auto ya = std::lower_bound(m.begin(), m.end(), y0 - n), yb = std::upper_bound(ya, m.end(), y1);
+		
+		for (auto x = xa; x != xb; ++x)
+		for (auto y = ya; y != yb; ++y)
+			if (n)
+				lines.emplace_back(Point(*x, *y), Point(*x + n, *y + n));
+			else
+				points.emplace_back(*x, *y);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CLONE_CLASSES_H
+#define CLONE_CLASSES_H
+
+#include "algorithm_ext.h"
+#include <cstdint>
+#include <vector>
+
+// Groups of identical windows that are too big to pair up. Consecutive
+// groups whose members all move on together form a class: every member
+// clones every other member over length windows. Storage is linear in the
+// number of members, pairs are only made for what is on screen.
+class CloneClasses
+{
+public:
+	typedef std::pair<std::int32_t, std::int32_t> Point;
+	typedef std::pair<Point, Point> Line;
+	
+	struct Class {
+		std::uint64_t first;  // Index of the first member
+		std::uint32_t size;
+		std::int32_t  length; // In windows
+	};
+	
+	void clear();
+	
+	// Members are the positions of the windows of one group.
+	void add_group(std::vector<int> members);
+	void build();
+	void assign(alg::array_view<Class> classes, alg::array_view<std::int32_t> members);
+	
+	alg::array_view<Class> classes() const { return m_classes; }
+	alg::array_view<std::int32_t> members() const { return m_members; }
+	alg::array_view<std::int32_t> members(const Class &c) const
+	{ return alg::array_view<std::int32_t>(m_members.data() + c.first, c.size); }
+	
+	// Pairs of all classes that may touch the box, runs of one window as points.
+	void visible(double x0, double y0, double x1, double y1,
+		std::vector<Point> &points, std::vector<Line> &lines) const;
+	
+private:
+	std::vector<Class> m_classes;
+	std::vector<std::int32_t> m_members;
+	std::vector<std::vector<int>> m_groups;
+};
+
+#endif // CLONE_CLASSES_H
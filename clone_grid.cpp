@@ -23,55 +23,64 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#define GL_GLEXT_PROTOTYPES
-
 #include "clone_grid.h"
 #include "algorithm_ext.h"
+#include "hash_detector.h"
+#include "index_cache.h"
+#include "profiler.h"
+#include "rasterizer.h"
 #include "sourcefile.h"
+#include "stream_detector.h"
+#include "watcher.h"
 
-#include <GL/glut.h>
+#include <GL/gl.h>
 #include <boost/format.hpp>
-#include <boost/regex.hpp>
-#include <boost/algorithm/string.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <parallel/algorithm>
 
 namespace fs = boost::filesystem;
 
+const int CloneGrid::s_pairs;
+
 CloneGrid::CloneGrid(int runs) :
-	m_runs(runs),
-	m_font("/usr/share/fonts/truetype/ttf-dejavu/DejaVuSansMono.ttf")
+	m_detector(new HashDetector),
+	m_runs(runs)
 {
-	if (m_font.Error())
-		std::cerr << "Could not load font.\n";
-	
-	m_font.FaceSize(15);
 }
 
 CloneGrid::~CloneGrid()
 {
-	for (SourceFile *file : m_files)
-		delete file;
+	if (m_worker.joinable()) m_worker.join();
+	delete m_detector;
+	delete m_cache;
+	delete m_watcher;
+}
+
+void CloneGrid::set_detector(IDetector *detector)
+{
+	delete m_detector;
+	m_detector = detector;
+}
+
+void CloneGrid::set_cache(const fs::path &path)
+{
+	m_cache_path = path;
 }
 
 void CloneGrid::read_source(const fs::path &path)
 {
-	boost::regex exclude(".*/(build|test|third_party|\\..*)");
-	boost::regex include(".*\\.(h|c|hpp|cpp|cc|cs|java|py|rb|php|hs|sh|y|ll|diff)|CMakeLists\\.txt");
-	
-	try {
-		for (fs::recursive_directory_iterator it(path), last; it != last; ++it)
-			if (boost::regex_match(it->path().string(), exclude))
-				it.no_push();
-			else if (
-				it->symlink_status().type() == fs::regular_file &&
-				boost::regex_match(it->path().string(), include)
-			)
-				read_lines(path, it->path());
-		
-	} catch (fs::filesystem_error &e) {
-		std::cerr << e.what() << "\n";
+	Profiler::Phase phase("walk");
+	std::size_t before = m_files.size();
+	for (const std::string &file : m_filter.walk(path.string())) {
+		m_sources.emplace_back(file, path.string().size());
+		m_sources.back().m_tree = m_trees;
+		m_files.push_back(&m_sources.back());
 	}
+	m_trees++;
+	phase.items(m_files.size() - before);
 }
 
 void CloneGrid::print_statistics()
@@ -79,6 +88,7 @@ void CloneGrid::print_statistics()
 	std::cout << boost::format("Total size:  %.3f MiB\n") % (m_bytes / 1024. / 1024.);
 	std::cout << "Total LOC:   " << m_size << "\n";
 	std::cout << "Total files: " << m_files.size() << "\n";
+	Profiler::print(std::cout);
 
 	std::size_t n = std::min(std::size_t(10), m_files.size());
 	std::cout << "\nTop-" << n << " biggest files:\n";
@@ -89,7 +99,7 @@ void CloneGrid::print_statistics()
 		[] (SourceFile *a, SourceFile *b) { return a->line_count() > b->line_count(); }
 	);
 	
-	int tloc = 0;
+	std::size_t tloc = 0;
 	for (std::size_t i = 0; i < n; ++i) {
 		tloc += files_sorted[i]->line_count();
 		std::cout << *files_sorted[i];
@@ -98,139 +108,850 @@ void CloneGrid::print_statistics()
 	std::cout << boost::format("LOC: %d (%.3f%%)\n\n") % tloc % (double(tloc) / m_size * 100.);
 }
 
-typedef std::pair<int, int> IPoint;
-inline static IPoint align(const IPoint &p) { return IPoint(p.first - p.second, p.second); }
-inline static IPoint reset(const IPoint &p) { return IPoint(p.first + p.second, p.second); }
-inline static bool aligned(const IPoint &a, const IPoint &b)
-{ return a.first == b.first && a.second + 1 == b.second; }
+typedef CloneGrid::IPoint IPoint;
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double> seconds;
+
+static const std::size_t s_chunk = 1 << 16; // First points shown while loading
+static const std::size_t s_preview = 1 << 18; // Enough for the picture, the rest waits
+
+// Adds the pairs of a group of identical windows, [first, last], that are
+// across, unless the group is too big to pair up. The grid is symmetric,
+// so only pairs above the diagonal are kept, the other half is drawn
+// mirrored.
+template<typename Iterator, typename Across>
+static bool group_pairs(Iterator first, Iterator last, std::vector<IPoint> &points, Across across)
+{
+	if (++last - first >= CloneGrid::s_pairs) return false;
+	for (auto i1 = first; i1 != last; ++i1)
+	for (auto i2 = i1 + 1; i2 != last; ++i2) {
+		IPoint p(std::min(*i1, *i2), std::max(*i1, *i2));
+		if (across(p.first, p.second)) points.push_back(CloneGrid::align(p));
+	}
+	return true;
+}
+
+// Chains of aligned points, sorted, as runs.
+static std::vector<std::pair<IPoint, int>> chains(const std::vector<IPoint> &points)
+{
+	std::vector<std::pair<IPoint, int>> runs;
+	for (std::size_t i = 0, j; i < points.size(); i = j) {
+		for (j = i + 1; j < points.size() && CloneGrid::aligned(points[j - 1], points[j]); ++j);
+		runs.emplace_back(points[i], j - i);
+	}
+	return runs;
+}
+
+template<typename Iterator>
+static std::vector<int> group_members(Iterator first, Iterator last)
+{
+	std::vector<int> members;
+	for (++last; first != last; ++first)
+		members.push_back(*first);
+	std::sort(begin(members), end(members));
+	return members;
+}
 
 void CloneGrid::finalize()
 {
-	std::cout << "Find clones" << std::endl;
+	if (load_cache()) return;
+	
+	// Watching needs the corpus, so then it is always read.
+	bool streaming = m_budget && !m_watch, ok = true;
+	StreamDetector stream(m_budget / 2);
+	if (streaming)
+		stream_files(stream);
+	else
+		read_files();
+	if (m_compare && !streaming) prune_windows();
 	
-	size_t clones_0 = 0, clones_1 = 0;
 	std::vector<IPoint> points;
-	__gnu_parallel::sort(begin(m_lines), end(m_lines), [&] (const SourceLine &a, const SourceLine &b) {
-		return std::lexicographical_compare(a[0], a[m_runs], b[0], b[m_runs]);
-	});
-	alg::process_adjacent(begin(m_lines), end(m_lines),
-		[&] (const SourceLine &a, const SourceLine &b) {
-			return alg::equal(a[0], a[m_runs], b[0], b[m_runs]);
-		}, [] (Lines::iterator, Lines::iterator) {},
-		[&] (Lines::iterator first, Lines::iterator last) {
-			if (++last - first >= 10) return;
-			clones_0 += 1;
-			clones_1 += last - first;
-			for (auto i1 = first; i1 != last; ++i1)
-			for (auto i2 = first; i2 != last; ++i2)
-				points.push_back(align(IPoint(i1->position(), i2->position())));
+	std::size_t handed = 0;
+	hand_over(points, handed);
+	
+	std::cout << "Find clones (" << (streaming ? "stream" : m_detector->name()) << ")" << std::endl;
+	Clock::time_point t0 = Clock::now();
+	
+	// Detectors that find whole runs pair up the small groups themselves,
+	// then the points are only listed when watching or reporting. When
+	// comparing, groups on one side and the parts of runs that are not
+	// from A to B are left out.
+	size_t clones_0 = 0, clones_1 = 0, pairs = 0;
+	bool by_runs = true, keep = m_watch || !m_report_path.empty();
+	Runs runs;
+	auto across = [this] (int a, int b) { return this->across(a, b); };
+	auto group = [&] (Lines::iterator first, Lines::iterator last) {
+		if (m_compare) {
+			auto ends = std::minmax_element(first, last + 1);
+			if (!across(*ends.first, *ends.second)) return;
 		}
-	);
+		clones_0 += 1;
+		clones_1 += last + 1 - first;
+		if (by_runs ? last + 1 - first >= s_pairs : !group_pairs(first, last, points, across))
+			m_classes.add_group(group_members(first, last));
+		if (handed < s_preview && points.size() >= std::min(2 * handed + s_chunk, s_preview))
+			hand_over(points, handed);
+		if (m_report_path.empty()) return;
+		
+		std::vector<int> members = group_members(first, last);
+		m_members.insert(m_members.end(), members.begin(), members.end());
+		m_groups.push_back(m_members.size());
+	};
+	auto run = [&] (std::uint32_t a, std::uint32_t b, std::uint32_t length) {
+		if (m_compare) {
+			std::uint32_t split = m_split, from = b < split ? split - b : 0;
+			length = std::min(length, a < split ? split - a : 0);
+			if (from >= length) return;
+			a += from; b += from; length -= from;
+		}
+		pairs += length;
+		if (!keep) runs.emplace_back(align(IPoint(a, b)), length);
+		for (std::uint32_t i = 0; i < length && (keep || (m_loading && points.size() < s_preview)); ++i)
+			points.push_back(align(IPoint(a + i, b + i)));
+		if (handed < s_preview && points.size() >= std::min(2 * handed + s_chunk, s_preview))
+			hand_over(points, handed);
+	};
+	
+	// Streaming, the pairs of every group go to disk as well.
+	ExternalSort<IPoint> sorted(m_budget / 2);
+	if (streaming) {
+		by_runs = false;
+		ok = stream.detect([&] (Lines::iterator first, Lines::iterator last) {
+			group(first, last);
+			for (const IPoint &p : points) sorted.push(p);
+			points.clear();
+		});
+		pairs = sorted.size();
+	} else if (!m_detector->detect_runs(m_corpus, m_lines, m_runs, s_pairs, group, run)) {
+		by_runs = false;
+		m_detector->detect(m_corpus, m_lines, m_runs, group);
+		pairs = points.size();
+	}
 	
-	m_lines.clear();
-	std::cout << "Clones:      " << clones_0 << ":" << clones_1 << ":" << points.size() << "\n";
+	Lines().swap(m_lines);
+	Profiler::Phase classes("classes");
+	m_classes.build();
+	classes.items(m_classes.members().size());
+	classes.end();
+	std::cout << "Clones:      " << clones_0 << ":" << clones_1 << ":" << pairs << "\n";
+	std::cout << "Classes:     " << m_classes.classes().size() << ":" << m_classes.members().size() << "\n";
 	std::cout << boost::format("Redundancy:  %.3f%%\n")  % (double(clones_1 - clones_0) / m_size * 100.);
+	std::cout << boost::format("Duration:    %.3f s\n") % seconds(Clock::now() - t0).count();
 	
 	std::cout << "Find runs" << std::endl;
-	typedef std::vector<IPoint>::iterator iterator;
-	__gnu_parallel::sort(begin(points), end(points));
-	alg::process_adjacent(begin(points), end(points), aligned,
-		[&] (iterator first, iterator last) {
-			std::transform(first, ++last, std::back_inserter(m_vertices), reset);
-		}, [&] (iterator first, iterator last) {
-			m_vlines.emplace_back(reset(*first), reset(*last));
+	if (streaming) {
+		Profiler::Phase merge("merge points", sorted.size());
+		ok &= sorted.merge([&] (const IPoint &p) {
+			if (!runs.empty() && aligned(IPoint(runs.back().first.first, runs.back().first.second + runs.back().second - 1), p))
+				runs.back().second++;
+			else
+				runs.emplace_back(p, 1);
+		});
+		merge.end();
+		add_runs(runs);
+	} else if (by_runs && !keep) {
+		std::vector<IPoint>().swap(points);
+		add_runs(runs);
+	} else {
+		Profiler::Phase sort("sort points", points.size());
+		__gnu_parallel::sort(begin(points), end(points));
+		sort.end();
+		find_runs(points);
+	}
+	
+	if (!ok)
+		std::cerr << "Could not use a temporary file, clones are missing\n";
+	
+	if (!m_cache_path.empty() && streaming)
+		std::cout << "Cache:       not written, the corpus was not kept\n";
+	else if (!m_cache_path.empty()) {
+		m_corpus.hash(m_runs);
+		Profiler::Phase phase("write cache", m_files.size());
+		IndexCache::write(m_cache_path, m_runs, m_normalize, m_compare, m_detector->exact(), m_files, m_corpus, m_vertices, m_vlines, m_classes);
+	}
+	
+	if (!m_report_path.empty()) {
+		Profiler::Phase phase("report", m_groups.size());
+		if (!streaming) runs = chains(points);
+		write_report(m_report_path, runs);
+	}
+	if (m_watch) {
+		m_points.swap(points);
+		watch();
+	}
+	
+	std::cout << "Done" << std::endl;
+}
+
+void CloneGrid::finalize_async()
+{
+	m_loading = true;
+	m_indexed = false;
+	m_worker = std::thread([this] {
+		finalize();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_handoff.done = true;
+	});
+}
+
+// Worker side of finalize_async(): the files are read, and the points from
+// handed on are new. Chunks double in size, so little is redone on screen,
+// and windows come in hash order, so any chunk is spread over the grid.
+void CloneGrid::hand_over(const std::vector<IPoint> &points, std::size_t &handed)
+{
+	if (!m_loading) return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_handoff.indexed = true;
+	for (; handed < points.size(); ++handed)
+		m_handoff.points.push_back(reset(points[handed]));
+}
+
+void CloneGrid::find_runs(const std::vector<IPoint> &points)
+{
+	typedef std::vector<IPoint>::const_iterator iterator;
+	Profiler::Phase phase("find runs", points.size());
+	typedef std::pair<std::vector<Point>, std::vector<Line>> Runs;
+	m_vertices.clear();
+	m_vlines.clear();
+	alg::parallel_process_adjacent<Runs>(begin(points), end(points), aligned,
+		[] (Runs &runs, iterator first, iterator last) {
+			std::transform(first, ++last, std::back_inserter(runs.first), reset);
+		}, [] (Runs &runs, iterator first, iterator last) {
+			runs.second.emplace_back(reset(*first), reset(*last));
+		}, [&] (const Runs &runs) {
+			m_vertices.insert(m_vertices.end(), runs.first.begin(), runs.first.end());
+			m_vlines.insert(m_vlines.end(), runs.second.begin(), runs.second.end());
 		}
 	);
+	SpatialIndex::arrange(m_vertices, m_vlines);
+}
+
+// Like find_runs(), from runs that a detector found, at aligned positions.
+// There too the first point of a line is also a vertex.
+void CloneGrid::add_runs(Runs &runs)
+{
+	Profiler::Phase phase("find runs", runs.size());
+	__gnu_parallel::sort(begin(runs), end(runs));
+	m_vertices.clear();
+	m_vlines.clear();
+	for (const auto &run : runs) {
+		m_vertices.push_back(reset(run.first));
+		if (run.second > 1)
+			m_vlines.emplace_back(reset(run.first), reset(IPoint(run.first.first, run.first.second + run.second - 1)));
+	}
+	SpatialIndex::arrange(m_vertices, m_vlines);
+}
+
+bool CloneGrid::add_pairs(Lines &bucket, std::vector<IPoint> &points)
+{
+	bool large = false;
+	if (bucket.size() < 2) return large;
+	HashDetector::verify(m_corpus, begin(bucket), end(bucket), m_runs,
+		[&] (Lines::iterator first, Lines::iterator last) {
+			large |= !group_pairs(first, last, points, [this] (int a, int b) { return across(a, b); });
+		}
+	);
+	return large;
+}
+
+// In compare mode, a window can only pair across when its hash is on the
+// other side too. One bit per hash and side finds nearly all that are not,
+// in linear time, before any detector sorts them. The few that share a bit
+// by chance are left out with their groups later.
+void CloneGrid::prune_windows()
+{
+	Profiler::Phase phase("prune windows", m_lines.size());
+	m_corpus.hash(m_runs);
 	
-	std::cout << "Done" << std::endl;
+	// About 8 bits per window, from the top bits of the hash.
+	int shift = 61;
+	while (shift > 32 && (std::size_t(1) << (64 - shift)) < 8 * m_lines.size()) --shift;
+	std::vector<bool> sides[2] = {
+		std::vector<bool>(std::size_t(1) << (64 - shift)),
+		std::vector<bool>(std::size_t(1) << (64 - shift))
+	};
+	for (std::uint32_t line : m_lines)
+		sides[line >= std::uint32_t(m_split)][m_corpus.window(line) >> shift] = true;
+	
+	std::size_t windows = m_lines.size();
+	m_lines.erase(std::remove_if(begin(m_lines), end(m_lines), [&] (std::uint32_t line) {
+		return !sides[line < std::uint32_t(m_split)][m_corpus.window(line) >> shift];
+	}), end(m_lines));
+	std::cout << "Compare:     " << m_lines.size() << "/" << windows << " windows on both sides\n";
+}
+
+// Files are in the order they were read, so B starts at its first file.
+void CloneGrid::find_split()
+{
+	auto b = std::find_if(begin(m_files), end(m_files), [] (const SourceFile *file) { return file->m_tree > 0; });
+	m_split = !m_compare ? 0 : b == end(m_files) ? m_size : (*b)->m_position;
+}
+
+void CloneGrid::find_classes()
+{
+	m_classes.clear();
+	for (auto &bucket : m_buckets)
+		if (bucket.second.size() >= std::size_t(s_pairs))
+			HashDetector::verify(m_corpus, begin(bucket.second), end(bucket.second), m_runs,
+				[&] (Lines::iterator first, Lines::iterator last) {
+					if (last + 1 - first < s_pairs) return;
+					std::vector<int> members = group_members(first, last);
+					if (across(members.front(), members.back()))
+						m_classes.add_group(std::move(members));
+				}
+			);
+	m_classes.build();
 }
 
-SourceFile *CloneGrid::get_file(int position)
+void CloneGrid::watch()
 {
-	if (position < 0 || position >= m_size) return nullptr;
+	m_watcher = new Watcher;
+	m_corpus.hash(m_runs);
+	Profiler::Phase phase("watch", m_files.size());
+	std::vector<fs::path> directories;
+	for (SourceFile *file : m_files) {
+		alg::array_view<std::uint64_t> windows = m_corpus.windows(*file, m_runs);
+		for (std::size_t i = 0; i < windows.size(); ++i)
+			m_buckets[windows[i]].push_back(file->m_position + i);
+		
+		m_paths[file->m_path.string()] = file;
+		directories.push_back(file->m_path.parent_path());
+	}
 	
-	return *(std::upper_bound(
-		begin(m_files), end(m_files), position,
-		[] (int pos, const SourceFile *file) { return pos < file->m_position; }
-	) - 1);
+	std::sort(begin(directories), end(directories));
+	directories.erase(std::unique(begin(directories), end(directories)), end(directories));
+	for (const fs::path &directory : directories)
+		m_watcher->add(directory);
 }
 
-void CloneGrid::read_lines(const fs::path &root, const fs::path &path)
+// Uploads after from the first element that differs from before, each
+// element converted to one U.
+template<typename T, typename U>
+static void patch_buffer(Renderer::Layer &layer, const std::vector<T> &before, const std::vector<T> &after,
+	std::vector<U> (*convert)(alg::array_view<T>))
 {
-	SourceFile *file = new SourceFile(path, std::string(
-		begin(path.string()) + root.string().size(),
-		end  (path.string())
-	), m_size);
-	m_files.push_back(file);
-	m_bytes += file->read();
-	std::cout << *file;
+	std::size_t n = std::min(before.size(), after.size());
+	std::size_t first = std::mismatch(begin(after), begin(after) + n, begin(before)).first - begin(after);
 	
-	for (int i = 0; i <= int(file->line_count()) - m_runs; ++i)
-		m_lines.emplace_back(file, i);
+	if (layer.reserve(after.size() * sizeof(U)))
+		first = 0;
+	if (first < after.size()) {
+		std::vector<U> data = convert(alg::array_view<T>(&after[first], after.size() - first));
+		layer.write(first * sizeof(U), data.data(), data.size() * sizeof(U));
+	}
+}
+
+// Render thread side of finalize_async(), shows the points found so far
+// until the worker is done, then everything.
+bool CloneGrid::take_over()
+{
+	bool indexed, done;
+	std::vector<Point> points;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		indexed = m_handoff.indexed;
+		done = m_handoff.done;
+		points.swap(m_handoff.points);
+	}
+	
+	if (done) {
+		m_worker.join();
+		m_loading = false;
+		m_indexed = true;
+		m_preview = std::vector<Point>();
+		upload();
+		print_statistics();
+		return true;
+	}
 	
-	m_size += file->line_count();
+	bool changed = indexed != m_indexed;
+	m_indexed = indexed;
+	if (points.empty()) return changed;
+	
+	Profiler::Phase phase("preview", points.size());
+	std::vector<Line> lines;
+	m_preview.insert(end(m_preview), begin(points), end(points));
+	SpatialIndex::arrange(m_preview, lines);
+	patch_buffer(m_point_layer, std::vector<Point>(), m_preview, SpatialIndex::vertices);
+	m_index.build(m_preview, lines);
+	m_pyramid.build(m_preview, lines, m_size, CloneClasses(), m_split);
+	m_pyramid.setup();
+	return true;
 }
 
-void CloneGrid::setup()
+bool CloneGrid::update()
 {
-	glGenBuffers(3, vboId);
+	if (m_loading) return take_over();
+	if (!m_watcher) return false;
+	
+	std::vector<SourceFile *> changed;
+	for (const fs::path &path : m_watcher->poll()) {
+		auto it = m_paths.find(path.string());
+		if (it != m_paths.end()) changed.push_back(it->second);
+	}
+	if (changed.empty()) return false;
+	
+	Profiler::Phase phase("update", changed.size());
+	Clock::time_point t0 = Clock::now();
+	auto is_changed = [&] (std::uint32_t line) {
+		return std::find(begin(changed), end(changed), get_file(line)) != end(changed);
+	};
+	auto windows = [&] (const std::vector<SourceFile *> &files, const Corpus &corpus) {
+		std::vector<std::uint64_t> hashes;
+		for (SourceFile *file : files) {
+			alg::array_view<std::uint64_t> w = corpus.windows(*file, m_runs);
+			hashes.insert(end(hashes), w.begin(), w.end());
+		}
+		std::sort(begin(hashes), end(hashes));
+		hashes.erase(std::unique(begin(hashes), end(hashes)), end(hashes));
+		return hashes;
+	};
+	
+	// Take out the pairs of every bucket a changed file had a window in.
+	std::vector<std::uint64_t> affected = windows(changed, m_corpus);
+	std::vector<IPoint> removed, added;
+	bool large = false;
+	for (std::uint64_t hash : affected) {
+		Lines &bucket = m_buckets[hash];
+		large |= add_pairs(bucket, removed);
+		bucket.erase(std::remove_if(begin(bucket), end(bucket), is_changed), end(bucket));
+	}
+	
+	// Near-miss pairs are in no bucket, those of the changed files go until
+	// the next full analysis finds them again.
+	if (!m_detector->exact())
+		for (const IPoint &point : m_points) {
+			IPoint p = reset(point);
+			if (is_changed(p.first) || is_changed(p.second)) removed.push_back(point);
+		}
+	
+	std::vector<int> positions;
+	for (SourceFile *file : m_files)
+		positions.push_back(file->m_position);
+	
+	// The old corpus stays until the buckets have moved to the new positions.
+	Corpus corpus;
+	corpus.update(m_corpus, m_files, changed, m_normalize);
+	corpus.hash(m_runs);
+	
+	// Buckets that only gain windows lose their pairs too, e.g. when they
+	// grow too big. Still at the old positions, like m_points.
+	std::vector<std::uint64_t> gained = windows(changed, corpus);
+	for (std::uint64_t hash : gained) {
+		auto it = m_buckets.find(hash);
+		if (it != m_buckets.end() && !std::binary_search(begin(affected), end(affected), hash))
+			large |= add_pairs(it->second, removed);
+	}
+	
+	bool shifted = false;
+	m_size = m_bytes = 0;
+	for (std::size_t i = 0; i < m_files.size(); ++i) {
+		shifted |= m_files[i]->m_position != positions[i];
+		m_size  += m_files[i]->line_count();
+		m_bytes += m_files[i]->m_bytes;
+	}
+	m_file_index.build(m_files, m_size);
+	find_split();
+	auto move = [&] (int p) {
+		std::size_t i = std::upper_bound(begin(positions), end(positions), p) - begin(positions) - 1;
+		return p - positions[i] + m_files[i]->m_position;
+	};
+	
+	// Windows behind the changed files move along with their lines.
+	if (shifted)
+		for (auto &bucket : m_buckets)
+			for (std::uint32_t &line : bucket.second)
+				line = move(line);
+	m_corpus.swap(corpus);
+	corpus = Corpus();
+	
+	// Put the changed files back, and pair up their buckets again.
+	for (SourceFile *file : changed) {
+		alg::array_view<std::uint64_t> w = m_corpus.windows(*file, m_runs);
+		for (std::size_t i = 0; i < w.size(); ++i)
+			m_buckets[w[i]].push_back(file->m_position + i);
+	}
+	
+	affected.insert(end(affected), begin(gained), end(gained));
+	std::sort(begin(affected), end(affected));
+	affected.erase(std::unique(begin(affected), end(affected)), end(affected));
+	for (std::uint64_t hash : affected) {
+		auto it = m_buckets.find(hash);
+		large |= add_pairs(it->second, added);
+		if (it->second.empty()) m_buckets.erase(it);
+	}
+	
+	std::sort(begin(removed), end(removed));
+	std::sort(begin(added), end(added));
+	
+	std::vector<IPoint> points;
+	points.reserve(m_points.size() - removed.size());
+	std::set_difference(
+		begin(m_points), end(m_points), begin(removed), end(removed),
+		std::back_inserter(points)
+	);
+	
+	// Line counts changed, move everything behind the changed files along.
+	if (shifted) {
+		for (IPoint &point : points) {
+			IPoint p = reset(point);
+			point = align(IPoint(move(p.first), move(p.second)));
+		}
+		__gnu_parallel::sort(begin(points), end(points));
+	}
+	
+	m_points.clear();
+	std::merge(
+		begin(points), end(points), begin(added), end(added),
+		std::back_inserter(m_points)
+	);
+	points = std::vector<IPoint>();
+	
+	// Clone classes span many buckets, redo them all when one is involved.
+	// Otherwise their members only move along.
+	if (large)
+		find_classes();
+	else if (shifted) {
+		std::vector<CloneClasses::Class> classes(m_classes.classes().begin(), m_classes.classes().end());
+		std::vector<std::int32_t> members(m_classes.members().begin(), m_classes.members().end());
+		for (std::int32_t &p : members)
+			p = move(p);
+		m_classes.assign(classes, members);
+	}
+	
+	std::vector<Point> vertices(std::move(m_vertices));
+	std::vector<Line> vlines(std::move(m_vlines));
+	find_runs(m_points);
+	
+	patch_buffer(m_point_layer, vertices, m_vertices, SpatialIndex::vertices);
+	patch_buffer(m_run_layer, vlines, m_vlines, SpatialIndex::runs);
+	m_index.build(m_vertices, m_vlines);
+	m_pyramid.build(m_vertices, m_vlines, m_size, m_classes, m_split);
+	m_pyramid.setup();
+	
+	m_text_stale = true;
+	std::cout << boost::format("Updated %d files in %.3f s\n")
+		% changed.size() % seconds(Clock::now() - t0).count();
+	return true;
+}
 
-	// Setup file borders:
-	m_lcount = 2 * m_files.size() + 2;
-	std::vector<float> vertices;
-	vertices.reserve(m_lcount * 4);
+bool CloneGrid::load_cache()
+{
+	if (m_cache_path.empty()) return false;
+	Profiler::Phase phase("load cache", m_files.size());
+	
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (std::size_t i = 0; i < m_files.size(); ++i)
+		m_files[i]->stat();
+	
+	m_cache = new IndexCache;
+	bool hit = !m_watch && m_report_path.empty() && m_cache->open(m_cache_path, m_runs, m_normalize, m_compare, m_detector->exact()) && m_cache->size() == m_files.size();
+	for (std::size_t i = 0; hit && i < m_files.size(); ++i)
+		hit = m_cache->matches(m_cache->entry(i), *m_files[i]) && m_cache->entry(i).tree == m_files[i]->m_tree;
+	
+	if (hit) {
+		// Nothing changed, files are only read once a snippet shows them.
+		for (std::size_t i = 0; i < m_files.size(); ++i) {
+			const IndexCache::Entry &entry = m_cache->entry(i);
+			m_files[i]->m_position = entry.position;
+			m_files[i]->m_count    = entry.lines;
+			m_size  += entry.lines;
+			m_bytes += entry.size;
+		}
+		m_file_index.build(m_files, m_size);
+		find_split();
+		m_classes.assign(m_cache->classes(), m_cache->class_members());
+		
+		std::cout << "Loaded " << m_cache_path.string() << std::endl;
+		return true;
+	}
+	
+	// Reuse the line hashes of the files that did not change.
+	std::size_t reused = 0;
+	for (SourceFile *file : m_files)
+		if (const IndexCache::Entry *entry = m_cache->find(*file)) {
+			alg::array_view<std::uint64_t> hashes = m_cache->hashes(*entry);
+			file->m_hashes.assign(hashes.begin(), hashes.end());
+			++reused;
+		}
+	
+	std::cout << "Cache:       " << reused << "/" << m_files.size() << " files unchanged\n";
+	delete m_cache;
+	m_cache = nullptr;
+	return false;
+}
 
-	float size = m_size;
+alg::array_view<CloneGrid::Point> CloneGrid::clone_points() const
+{
+	return m_cache ? m_cache->vertices() : alg::array_view<Point>(m_vertices);
+}
+
+alg::array_view<CloneGrid::Line> CloneGrid::clone_lines() const
+{
+	return m_cache ? m_cache->vlines() : alg::array_view<Line>(m_vlines);
+}
+
+void CloneGrid::read_files()
+{
+	// Positions follow the order of the walk, not the order of reading.
+	m_corpus.read(m_files, m_normalize);
+	m_size = m_corpus.size();
+	m_file_index.build(m_files, m_size);
+	find_split();
+	Profiler::Phase phase("list windows");
+	
+	std::size_t windows = 0;
+	for (SourceFile *file : m_files) {
+		m_bytes += file->m_bytes;
+		windows += std::max(int(file->line_count()) - m_runs + 1, 0);
+		std::cout << *file;
+	}
+	
+	m_lines.reserve(windows);
+	for (SourceFile *file : m_files)
+		for (int i = 0; i <= int(file->line_count()) - m_runs; ++i)
+			m_lines.push_back(file->m_position + i);
+	phase.items(m_lines.size());
+}
+
+// Like read_files(), but every file is hashed and dropped as it is read.
+void CloneGrid::stream_files(StreamDetector &stream)
+{
+	m_size = stream.read(m_files, m_normalize, m_runs);
+	m_file_index.build(m_files, m_size);
+	find_split();
+	
 	for (SourceFile *file : m_files) {
-		float p = file->m_position;
-		vertices.insert(end(vertices), {p, 0, p, size, 0, p, size, p});
+		m_bytes += file->m_bytes;
+		std::cout << *file;
+	}
+}
+
+static std::string escape(const std::string &text)
+{
+	std::string result;
+	for (char c : text)
+		if (c == '"' || c == '\\')
+			result.append({'\\', c});
+		else if (static_cast<unsigned char>(c) < 0x20)
+			result += (boost::format("\\u%04x") % int(c)).str();
+		else
+			result += c;
+	
+	return result;
+}
+
+std::string CloneGrid::location(int first, int last)
+{
+	FileIndex::Location at = locate(first);
+	return (boost::format("%s:%d-%d")
+		% at.file->m_path.string()
+		% (at.line + 1)
+		% (at.line + last - first + 1)
+	).str();
+}
+
+void CloneGrid::write_report(const fs::path &path, const Runs &chains)
+{
+	std::ofstream out(path.string());
+	bool csv = path.extension() == ".csv";
+	
+	struct Run { int x, y, n; };
+	std::vector<Run> runs;
+	
+	// Chains of aligned points, all above the diagonal, cut at file borders.
+	for (const auto &chain : chains) {
+		IPoint p = reset(chain.first);
+		
+		for (int n = chain.second; n > 0; ) {
+			SourceFile *a = get_file(p.first), *b = get_file(p.second);
+			int m = std::min({n,
+				int(a->m_position + a->line_count()) - p.first,
+				int(b->m_position + b->line_count()) - p.second
+			});
+			runs.push_back(Run{p.first, p.second, m});
+			p.first += m; p.second += m; n -= m;
+		}
 	}
+	
+	if (csv) {
+		out << "kind,id,location\n";
+		for (std::size_t g = 0; g < m_groups.size(); ++g)
+			for (std::size_t i = g ? m_groups[g - 1] : 0; i < m_groups[g]; ++i)
+				out << "group," << g << ",\"" << location(m_members[i], m_members[i] + m_runs - 1) << "\"\n";
+		
+		for (std::size_t r = 0; r < runs.size(); ++r) {
+			const Run &run = runs[r];
+			out << "run," << r << ",\"" << location(run.x, run.x + run.n + m_runs - 2) << "\"\n";
+			out << "run," << r << ",\"" << location(run.y, run.y + run.n + m_runs - 2) << "\"\n";
+		}
+		
+		for (std::size_t c = 0; c < m_classes.classes().size(); ++c) {
+			const CloneClasses::Class &cls = m_classes.classes()[c];
+			for (int p : m_classes.members(cls))
+				out << "class," << c << ",\"" << location(p, p + cls.length + m_runs - 2) << "\"\n";
+		}
+	} else {
+		out << "{\n\"runs\": " << m_runs << ",\n\"files\": " << m_files.size()
+			<< ",\n\"loc\": " << m_size << ",\n\"groups\": [";
+		for (std::size_t g = 0; g < m_groups.size(); ++g) {
+			out << (g ? ",\n" : "\n") << "[";
+			for (std::size_t i = g ? m_groups[g - 1] : 0; i < m_groups[g]; ++i)
+				out << (i == (g ? m_groups[g - 1] : 0) ? "" : ", ")
+					<< "\"" << escape(location(m_members[i], m_members[i] + m_runs - 1)) << "\"";
+			out << "]";
+		}
+		
+		out << "\n],\n\"clones\": [";
+		for (std::size_t r = 0; r < runs.size(); ++r) {
+			const Run &run = runs[r];
+			out << (r ? ",\n" : "\n") << "{\"lines\": " << run.n + m_runs - 1
+				<< ", \"a\": \"" << escape(location(run.x, run.x + run.n + m_runs - 2))
+				<< "\", \"b\": \"" << escape(location(run.y, run.y + run.n + m_runs - 2)) << "\"}";
+		}
+		out << "\n],\n\"classes\": [";
+		for (std::size_t c = 0; c < m_classes.classes().size(); ++c) {
+			const CloneClasses::Class &cls = m_classes.classes()[c];
+			out << (c ? ",\n" : "\n") << "{\"lines\": " << cls.length + m_runs - 1 << ", \"members\": [";
+			bool first = true;
+			for (int p : m_classes.members(cls)) {
+				out << (first ? "" : ", ") << "\"" << escape(location(p, p + cls.length + m_runs - 2)) << "\"";
+				first = false;
+			}
+			out << "]}";
+		}
+		out << "\n]\n}\n";
+	}
+	
+	if (!out)
+		std::cerr << "Could not write report " << path << "\n";
+	else
+		std::cout << "Report:      " << m_groups.size() << " groups, " << runs.size() << " clones, "
+			<< m_classes.classes().size() << " classes\n";
+}
 
-	vertices.insert(end(vertices), {size, 0, size, size, 0, size, size, size});
+void CloneGrid::write_image(const fs::path &path, int width)
+{
+	Profiler::Phase phase("image", std::size_t(width) * width);
+	std::vector<int> borders;
+	for (const SourceFile *file : m_files)
+		borders.push_back(file->m_position);
+	
+	Rasterizer rasterizer(m_size, std::move(borders), clone_points(), clone_lines(), m_classes, m_split);
+	if (!rasterizer.write(path, width))
+		std::cerr << "Could not write image " << path << "\n";
+	else
+		std::cout << "Image:       " << width << " x " << width << " pixels\n";
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[0]);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), &vertices[0]);
-	vertices.clear();
+// File borders in the box, relative to (px, py), at most one per pixel.
+void CloneGrid::border_vertices(double x0, double y0, double x1, double y1, double scale, int px, int py)
+{
+	auto positions = [&] (double first, double last) {
+		std::vector<int> result;
+		auto it = begin(m_files);
+		for (double p = std::max(0., first); p <= last; p = result.back() + std::max(1., 1 / scale)) {
+			it = std::lower_bound(it, end(m_files), p,
+				[] (const SourceFile *file, double p) { return file->m_position < p; }
+			);
+			int position = it == end(m_files) ? m_size : (*it)->m_position;
+			if (position > last) break;
+			result.push_back(position);
+			if (it == end(m_files)) break;
+		}
+		return result;
+	};
+	
+	m_stream.clear();
+	float top = std::max(0., y0) - py, bottom = std::min<double>(m_size, y1) - py;
+	for (int p : positions(x0, x1))
+		m_stream.insert(end(m_stream), {{p - px, top}, {p - px, bottom}});
+	
+	float left = std::max(0., x0) - px, right = std::min<double>(m_size, x1) - px;
+	for (int p : positions(y0, y1))
+		m_stream.insert(end(m_stream), {{left, p - py}, {right, p - py}});
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[1]);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Point), 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(Point), &m_vertices[0]);
+void CloneGrid::draw_batches(const Renderer::Layer &layer, unsigned int mode, int px, int py)
+{
+	std::size_t first = 0;
+	for (const SpatialIndex::Batch &batch : m_batches) {
+		Renderer::offset(double(batch.origin.first) - px, double(batch.origin.second) - py);
+		layer.draw(mode, &m_first[first], &m_count[first], batch.end - first);
+		first = batch.end;
+	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[2]);
-	glBufferData(GL_ARRAY_BUFFER, m_vlines.size() * sizeof(Line), 0, GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, m_vlines.size() * sizeof(Line), &m_vlines[0]);
+void CloneGrid::setup()
+{
+	// Loaded here, so a headless run never touches FreeType.
+	if (!m_font.load({
+		"/usr/share/fonts/truetype/ttf-dejavu/DejaVuSansMono.ttf",
+		"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+	}, 15))
+		std::cerr << "Could not load font.\n";
+	
+	if (!m_loading) upload();
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void CloneGrid::upload()
+{
+	Profiler::Phase phase("upload", clone_points().size() + clone_lines().size());
+
+	// Clone points and lines, relative to their blocks:
+	alg::array_view<Point> points = clone_points();
+	m_point_layer.upload(SpatialIndex::vertices(points));
+
+	alg::array_view<Line> lines = clone_lines();
+	m_run_layer.upload(SpatialIndex::runs(lines));
+	phase.end();
+
+	// Only needed on screen, so built here rather than in finalize.
+	Profiler::Phase build("build index", points.size() + lines.size());
+	m_index.build(points, lines);
+	m_pyramid.build(points, lines, m_size, m_classes, m_split);
+	m_pyramid.setup();
 }
 
-void CloneGrid::draw_snippet(int left, int top, int pc, double scale)
+void CloneGrid::layout_snippet(int left, int top, int pc, double scale)
 {
-	int font_size = m_font.FaceSize() - 2, lines = 20, n = lines / 4 + 1;
+	int font_size = m_font.size() - 2, lines = 20, n = lines / 4 + 1;
 
 	SourceFile *file = get_file(pc);
 
 	if (!file) return;
-	glColor4f(.5, 1, .5, 1);
-	m_font.Render(file->m_name.c_str(), -1, FTPoint(left, top - font_size));
+	if (m_corpus.empty() && m_loading) return;
+	
+	// Without the corpus, only this file is read again, as a corpus of its
+	// own. A copy of it is read, its position is that in the grid.
+	const Corpus *corpus = &m_corpus;
+	int base = 0, count = file->line_count();
+	if (m_corpus.empty()) {
+		if (m_snippet_file != file) {
+			SourceFile copy(*file);
+			m_snippet.read(Files{&copy});
+			m_snippet_file = file;
+		}
+		corpus = &m_snippet;
+		base = file->m_position;
+		count = std::min<int>(count, m_snippet.size());
+	}
+	unsigned char color[4] = {128, 255, 128, 255};
+	const char *name = file->name();
+	m_font.text(name, name + std::strlen(name), left, top - font_size, color, m_text);
 
 	if (scale <= 1/3.) return;
 	double a = sqrt(std::max(.0, 1.5 * scale - .5));
 	int p = file->m_position - pc;
 	int first = std::max(- lines, p);
-	int last  = std::min(  lines, p + int(file->line_count()) - 1) + 1;
+	int last  = std::min(  lines, p + count - 1) + 1;
 
-	while (first != last) {
-		glColor4f(.5, 1, .5, a * std::min((lines + 1. - std::abs(first)) / n, 1.));
-
-		std::string line(file->line(first - p), file->line(first - p + 1));
-		if (line.back() == '\n') line.resize(line.size() - 1);
-		boost::replace_all(line, "\t", "    ");
-		boost::replace_all(line, "\r", "");
-
-		m_font.Render(line.c_str(), -1,
-			FTPoint(left, - m_font.LineHeight() * first - font_size / 2)
-		);
+	// Straight from the corpus, the atlas expands tabs and skips CRs.
+	while (first < last) {
+		color[3] = 255 * a * std::min((lines + 1. - std::abs(first)) / n, 1.);
+		m_font.text(corpus->line(pc + first - base), corpus->line(pc + first - base + 1),
+			left, - m_font.line_height() * first - font_size / 2, color, m_text);
 
 		++first;
 	}
@@ -238,40 +959,87 @@ void CloneGrid::draw_snippet(int left, int top, int pc, double scale)
 
 void CloneGrid::draw(double scale, int width, int height, int px, int py)
 {
+	// Nothing to draw until the worker has read all files.
+	if (!m_indexed) return;
+	
+	// Everything is drawn relative to the view, so floats stay precise.
 	py = m_size - py;
-	glTranslated(0, m_size, 0);
-	glScaled(1, -1, 1);
-
-	// Draw file borders:
-	glColor4f(1, 0, 0, .6 * sqrt(scale));
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[0]);
-	glVertexPointer(2, GL_FLOAT, 0, 0);
-	glDrawArrays(GL_LINES, 0, m_lcount * 2);
-
-	// Draw blue diagonal:
-	glColor4f(0, 0, 1, 1);
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBegin(GL_LINES); glVertex2i(0, 0); glVertex2i(m_size, m_size); glEnd();
-
-	// Draw clone dots:
-	glColor4f(1, 1, 1, sqrt(sqrt(scale)));
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[1]);
-	glVertexPointer(2, GL_FLOAT, 0, 0);
-	glDrawArrays(GL_POINTS, 0, m_vertices.size());
-
-	// Draw clone lines:
-	glBindBuffer(GL_ARRAY_BUFFER, vboId[2]);
-	glVertexPointer(2, GL_FLOAT, 0, 0);
-	glDrawArrays(GL_LINES, 0, m_vlines.size() * 2);
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	// Draw code snippets:
+	Renderer::view(scale, width, height, true);
+	Renderer::offset(0, 0);
+
+	double x0 = px - width / 2. / scale, x1 = px + width / 2. / scale;
+	double y0 = py - height / 2. / scale, y1 = py + height / 2. / scale;
+
+	// Draw file borders, and the blue diagonal after them, unless comparing:
+	border_vertices(x0, y0, x1, y1, scale, px, py);
+	int borders = m_stream.size();
+	double d0 = std::max({0., x0, y0}), d1 = std::min({double(m_size), x1, y1});
+	if (d0 < d1 && !m_compare)
+		m_stream.insert(end(m_stream), {{d0 - px, d0 - py}, {d1 - px, d1 - py}});
+	m_overlay.upload(m_stream, true);
+	Renderer::color(1, 0, 0, .6, .5);
+	m_overlay.draw(GL_LINES, 0, borders);
+	Renderer::color(0, 0, 1, 1);
+	m_overlay.draw(GL_LINES, borders, m_stream.size() - borders);
+
+	// Draw clone density, or when zoomed in, the visible clone dots and lines:
+	if (!m_pyramid.draw(scale, x0, y0, x1, y1)) {
+		// Only the half above the diagonal is kept, the other half is the
+		// same buffers mirrored, found by mirroring the view. When comparing
+		// there is no other half.
+		Renderer::color(1, 1, 1, 1, .25);
+		for (bool mirror : {false, true}) {
+			if (mirror && m_compare) break;
+			Renderer::mirror(mirror);
+			double qx0 = mirror ? y0 : x0, qy0 = mirror ? x0 : y0, qx1 = mirror ? y1 : x1, qy1 = mirror ? x1 : y1;
+			m_index.points(qx0, qy0, qx1, qy1, m_first, m_count, m_batches);
+			draw_batches(m_point_layer, GL_POINTS, mirror ? py : px, mirror ? px : py);
+			
+			// One instanced line per run.
+			m_index.lines(qx0, qy0, qx1, qy1, m_first, m_count, m_batches);
+			draw_batches(m_run_layer, GL_LINES, mirror ? py : px, mirror ? px : py);
+		}
+		Renderer::mirror(false);
+
+		// Pairs of clone classes are only made for the visible part, once known.
+		if (m_loading) {
+			m_class_points.clear();
+			m_class_lines.clear();
+		} else
+			m_classes.visible(x0, y0, x1, y1, m_class_points, m_class_lines);
+		if (m_compare) {
+			m_class_points.erase(std::remove_if(begin(m_class_points), end(m_class_points),
+				[&] (const Point &p) { return !across(p.first, p.second); }), end(m_class_points));
+			m_class_lines.erase(std::remove_if(begin(m_class_lines), end(m_class_lines),
+				[&] (const Line &l) { return !across(l.first.first, l.first.second); }), end(m_class_lines));
+		}
+		m_stream.clear();
+		for (const Point &p : m_class_points)
+			m_stream.emplace_back(p.first - px, p.second - py);
+		for (const Line &l : m_class_lines)
+			m_stream.insert(end(m_stream), {
+				{l.first.first - px, l.first.second - py},
+				{l.second.first - px, l.second.second - py}
+			});
+		
+		Renderer::offset(0, 0);
+		m_class_layer.upload(m_stream, true);
+		m_class_layer.draw(GL_POINTS, 0, m_class_points.size());
+		m_class_layer.draw(GL_LINES, m_class_points.size(), m_class_lines.size() * 2);
+	}
+
+	// Draw code snippets, in one call:
 	int margin = 20;
-	glLoadIdentity();
-	draw_snippet(margin - width / 2, height / 2 - margin, py, scale);
-	draw_snippet(margin            , height / 2 - margin, px, scale);
+	Renderer::view(1, width, height);
+	Renderer::offset(0, 0);
+	std::array<double, 5> view = {{double(px), double(py), double(width), double(height), scale}};
+	if (m_text_stale || m_loading || view != m_text_view) {
+		m_text.clear();
+		layout_snippet(margin - width / 2, height / 2 - margin, py, scale);
+		layout_snippet(margin            , height / 2 - margin, px, scale);
+		m_text_layer.upload(m_text, true);
+		m_text_view = view;
+		m_text_stale = false;
+	}
+	m_font.draw(m_text_layer, m_text.size());
 }
@@ -28,51 +28,182 @@
 #define CLONE_GRID_H
 
 #include "idrawable.h"
+#include "algorithm_ext.h"
+#include "clone_classes.h"
+#include "corpus.h"
+#include "density_pyramid.h"
+#include "file_index.h"
+#include "glyph_atlas.h"
+#include "renderer.h"
+#include "source_filter.h"
+#include "sourcefile.h"
+#include "spatial_index.h"
 #include <boost/filesystem.hpp>
-#include <FTGL/ftgl.h>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
-class SourceFile;
-class SourceLine;
+class IDetector;
+class IndexCache;
+class StreamDetector;
+class Watcher;
 
 class CloneGrid : public virtual IDrawable
 {
 public:
+	typedef std::vector<SourceFile *> Files;
+	typedef std::pair<int, int> IPoint;
+	
+	static const int s_pairs = 10; // Bigger groups go into clone classes
+	
+	// Pairs above the diagonal are kept aligned, as (x - y, y), so sorted
+	// the points of a run are adjacent.
+	static IPoint align(const IPoint &p) { return IPoint(p.first - p.second, p.second); }
+	static IPoint reset(const IPoint &p) { return IPoint(p.first + p.second, p.second); }
+	static bool aligned(const IPoint &a, const IPoint &b) { return a.first == b.first && a.second + 1 == b.second; }
+	
 	CloneGrid(int runs = 4);
 	virtual ~CloneGrid();
 	
 	// Implement IDrawable
 	virtual void draw(double scale, int width, int height, int px, int py);
-	virtual double size() { return m_size; }
+	virtual double size() { return m_indexed ? m_size : 0; } // None until handed over
+	virtual bool update();
 	
+	void set_detector(IDetector *detector);
+	void set_cache(const boost::filesystem::path &path);
+	void set_watch(bool watch) { m_watch = watch; }
+	void set_normalize(Normalize normalize) { m_normalize = normalize; }
+	void set_runs(int runs) { m_runs = runs; }
+	void set_compare(bool compare) { m_compare = compare; }
+	void set_budget(std::size_t bytes) { m_budget = bytes; }
+	void set_report(const boost::filesystem::path &path) { m_report_path = path; }
+	void add_ignore(const std::string &rule) { m_filter.add_rule(rule); }
 	void read_source(const boost::filesystem::path &path);
 	void print_statistics();
 	void finalize();
 	void setup();
 	
+	// Runs finalize() on a worker thread, update() shows its progress.
+	void finalize_async();
+	
+	// The whole grid as a PNG of width x width pixels, without a window.
+	void write_image(const boost::filesystem::path &path, int width);
+	
+	// The file at a line position, or nullptr when outside the grid, and
+	// the line within it. For drawing, reports and exports alike.
+	SourceFile *get_file(int position) const { return m_file_index.file(position); }
+	FileIndex::Location locate(int position) const { return m_file_index.locate(position); }
+	const Files &files() const { return m_files; }
+	std::uint64_t bytes() const { return m_bytes; }
+	
 private:
-	typedef std::vector<SourceFile *> Files;
-	typedef std::vector<SourceLine> Lines;
-	typedef std::pair<float, float> Point;
+	typedef std::vector<std::uint32_t> Lines;
+	typedef std::pair<std::int32_t, std::int32_t> Point;
 	typedef std::pair<Point, Point> Line;
+	typedef std::vector<std::pair<IPoint, int>> Runs; // Aligned first points and lengths
 	
+	SourceFilter m_filter;
+	std::deque<SourceFile> m_sources;
 	Files m_files;
+	FileIndex m_file_index;
+	Corpus m_corpus;
 	Lines m_lines;
 	std::vector<Point> m_vertices;
 	std::vector<Line> m_vlines;
+	CloneClasses m_classes;
+	DensityPyramid m_pyramid;
+	SpatialIndex m_index;
+	std::vector<int> m_first, m_count;
+	std::vector<SpatialIndex::Batch> m_batches;
+	std::vector<Point> m_class_points;
+	std::vector<Line> m_class_lines;
+	std::vector<SpatialIndex::Vertex> m_stream;
 	
-	SourceFile *get_file(int position);
+	bool load_cache();
+	void upload();
+	alg::array_view<Point> clone_points() const;
+	alg::array_view<Line> clone_lines() const;
+	void find_runs(const std::vector<IPoint> &points);
+	void add_runs(Runs &runs);
+	bool add_pairs(Lines &bucket, std::vector<IPoint> &points);
+	void prune_windows();
+	void find_classes();
+	void border_vertices(double x0, double y0, double x1, double y1, double scale, int px, int py);
+	void draw_batches(const Renderer::Layer &layer, unsigned int mode, int px, int py);
 	
+	IDetector *m_detector;
+	IndexCache *m_cache = nullptr;
+	boost::filesystem::path m_cache_path;
 	int m_runs;
+	Normalize m_normalize = Normalize::none;
 	int m_size   = 0;
-	int m_bytes  = 0;
-	int m_lcount = 0;
+	std::uint64_t m_bytes = 0;
+	
+	// Streaming, with a budget for memory the text is dropped once hashed,
+	// and only the file of a snippet is read again.
+	std::size_t m_budget = 0;
+	Corpus m_snippet;
+	const SourceFile *m_snippet_file = nullptr;
+	void stream_files(StreamDetector &stream);
+	
+	// Compare mode, only clones between the first path read, A, and the
+	// others, B. The lines of A come first, up to m_split, so A x B is one
+	// rectangle of the grid, above the diagonal.
+	bool m_compare = false;
+	int m_trees = 0;
+	int m_split = 0;
+	void find_split();
+	bool across(int a, int b) const { return !m_compare || (a < m_split && b >= m_split); }
+	
+	// Borders and diagonal, clone points, clone lines as runs, clone classes, text.
+	Renderer::Layer m_overlay{Renderer::Layout::points};
+	Renderer::Layer m_point_layer{Renderer::Layout::points};
+	Renderer::Layer m_run_layer{Renderer::Layout::runs};
+	Renderer::Layer m_class_layer{Renderer::Layout::points};
+	Renderer::Layer m_text_layer{Renderer::Layout::glyphs};
+	
+	// Watch mode, keeps all windows by hash and all clone points.
+	bool m_watch = false;
+	Watcher *m_watcher = nullptr;
+	std::vector<IPoint> m_points;
+	std::unordered_map<std::uint64_t, Lines> m_buckets;
+	std::unordered_map<std::string, SourceFile *> m_paths;
+	void watch();
+	
+	// Asynchronous loading, the worker hands over its progress in
+	// m_handoff: file borders once all files are read, then the clone
+	// points found so far. take_over() shows it on the render thread.
+	struct Handoff {
+		bool indexed = false, done = false;
+		std::vector<Point> points;
+	};
+	std::thread m_worker;
+	std::mutex m_mutex;
+	Handoff m_handoff;
+	bool m_loading = false, m_indexed = true; // Render thread only
+	std::vector<Point> m_preview;
+	void hand_over(const std::vector<IPoint> &points, std::size_t &handed);
+	bool take_over();
 	
-	unsigned int vboId[3];
+	// Clone groups as offsets in m_members, only kept for the report.
+	boost::filesystem::path m_report_path;
+	std::vector<int> m_members;
+	std::vector<std::size_t> m_groups;
+	void write_report(const boost::filesystem::path &path, const Runs &runs);
+	std::string location(int first, int last);
 	
-	void read_lines(const boost::filesystem::path &root, const boost::filesystem::path &path);
-	void draw_snippet(int left, int top, int pc, double scale);
+	void read_files();
+	void layout_snippet(int left, int top, int pc, double scale);
 	
-	FTTextureFont m_font;
+	// Both snippets as glyph quads, laid out again when the view or the
+	// text changed.
+	GlyphAtlas m_font;
+	std::vector<GlyphAtlas::Vertex> m_text;
+	std::array<double, 5> m_text_view;
+	bool m_text_stale = true;
 };
 
 #endif // CLONE_GRID_H
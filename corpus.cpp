@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "corpus.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const std::uint64_t s_mul = 0xc6a4a7935bd1e995ull;
+static const std::uint64_t s_base = 0x100000001b3ull;
+static const std::uint64_t s_limit = std::numeric_limits<std::uint32_t>::max();
+
+const std::size_t Corpus::s_slack;
+
+static inline std::uint64_t mix(std::uint64_t h)
+{
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+	return h ^ (h >> 33);
+}
+
+// MurmurHash64A style hash, eight bytes at a time.
+static std::uint64_t hash_bytes(const char *data, std::size_t size)
+{
+	std::uint64_t h = size * s_mul;
+	for (; size >= 8; data += 8, size -= 8) {
+		std::uint64_t k;
+		std::memcpy(&k, data, 8);
+		k *= s_mul; k ^= k >> 47; k *= s_mul;
+		h ^= k; h *= s_mul;
+	}
+	
+	std::uint64_t k = 0;
+	std::memcpy(&k, data, size);
+	return mix(h ^ k);
+}
+
+// One large read per file, straight into its place in the corpus.
+static std::size_t read_file(SourceFile &file, char *data, std::size_t capacity)
+{
+	std::size_t size = 0;
+	int fd = ::open(file.m_path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd >= 0 && ::fstat(fd, &st) == 0) {
+		file.m_mtime = std::int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+		while (size < capacity) {
+			ssize_t n = ::read(fd, data + size, capacity - size);
+			if (n <= 0) break;
+			size += n;
+		}
+	} else {
+		std::cerr << file.m_path.string() + ": " + std::strerror(errno) + "\n";
+	}
+	if (fd >= 0) ::close(fd);
+	return size;
+}
+
+namespace {
+
+enum : unsigned char { other, space, quote, word, digit };
+
+struct Classes {
+	unsigned char c[256];
+	
+	Classes() {
+		for (int i = 0; i < 256; ++i)
+			c[i] = std::isspace(i) ? space : std::isdigit(i) ? digit :
+				std::isalpha(i) || i == '_' || i >= 0x80 ? word :
+				i == '"' || i == '\'' ? quote : other;
+	}
+};
+
+const Classes s_classes;
+
+const std::unordered_set<std::string> s_keywords = {
+	"auto", "break", "case", "catch", "class", "const", "continue", "default",
+	"delete", "do", "else", "enum", "extends", "false", "final", "for", "foreach",
+	"function", "if", "implements", "import", "in", "interface", "namespace",
+	"new", "null", "nullptr", "private", "protected", "public", "return",
+	"static", "struct", "super", "switch", "template", "this", "throw", "true",
+	"try", "typedef", "typename", "union", "using", "var", "virtual", "void",
+	"while", "yield",
+};
+
+}
+
+// Whitespace: leading and trailing whitespace is dropped, other runs of
+// whitespace become one space, so indentation and CRLF no longer matter.
+// Tokens: identifiers other than keywords become 'i', number, string and
+// character literals become '0', '""' and "''", whitespace only remains
+// between two words. A quote left open runs to the end of its line, a lone
+// one stays one character. No line grows, apart from the '\n' that ends
+// the last one, so the text grows by at most one byte.
+static std::size_t normalize_text(const char *data, std::size_t size, char *out, Normalize normalize)
+{
+	bool tokens = normalize == Normalize::tokens;
+	const char *end = data + size;
+	char *result = out;
+	
+	auto type = [] (char c) { return s_classes.c[static_cast<unsigned char>(c)]; };
+	for (const char *line = data; line; ) {
+		const char *last = static_cast<const char *>(std::memchr(line, '\n', end - line));
+		const char *next = last ? last + 1 : nullptr;
+		if (!last) last = end;
+		char *start = out;
+		bool gap = false;
+		
+		for (const char *it = line; it != last; ) {
+			unsigned char c = type(*it);
+			if (c == space) {
+				gap = true;
+				++it;
+				continue;
+			}
+			
+			const char *first = it++;
+			if (!tokens)
+				while (it != last && type(*it) != space) ++it;
+			else if (c == quote) {
+				for (; it != last && *it != *first; ++it)
+					if (*it == '\\' && it + 1 != last) ++it;
+				if (it != last) ++it;
+			} else if (c >= word)
+				while (it != last && type(*it) >= word) ++it;
+			
+			if (gap && out != start && (!tokens || (c >= word && type(out[-1]) >= word)))
+				*out++ = ' ';
+			gap = false;
+			
+			if (!tokens || c == other)
+				out = std::copy(first, it, out);
+			else if (c == quote)
+				out = std::fill_n(out, std::min<std::ptrdiff_t>(it - first, 2), *first);
+			else if (c == digit)
+				*out++ = '0';
+			else if (s_keywords.count(std::string(first, it)))
+				out = std::copy(first, it, out);
+			else
+				*out++ = 'i';
+		}
+		
+		*out++ = '\n';
+		line = next;
+	}
+	
+	return out - result;
+}
+
+std::size_t Corpus::normalize(const char *data, std::size_t size, char *out, Normalize normalize)
+{
+	return normalize_text(data, size, out, normalize);
+}
+
+// Rolling hashes of the windows of runs lines, count - runs + 1 of them.
+static void roll(const std::uint64_t *hashes, std::size_t count, int runs, std::uint64_t *windows)
+{
+	if (count < std::size_t(runs)) return;
+	
+	std::uint64_t h = 0, power = 1;
+	for (int i = 0; i < runs; ++i) {
+		h = h * s_base + hashes[i];
+		if (i) power *= s_base;
+	}
+	
+	windows[0] = h;
+	for (std::size_t i = runs; i < count; ++i) {
+		h = (h - hashes[i - runs] * power) * s_base + hashes[i];
+		windows[i - runs + 1] = h;
+	}
+}
+
+// Offsets of the first count lines of text, which starts at offset.
+static void index_lines(const char *text, std::size_t size, std::uint32_t offset, std::uint32_t *out, std::size_t count)
+{
+	const char *it = text, *last = text + size;
+	for (std::uint32_t *end = out + count; out != end; ++it) {
+		*out++ = offset + (it - text);
+		it = static_cast<const char *>(std::memchr(it, '\n', last - it));
+		if (!it) break;
+	}
+}
+
+void Corpus::read(const Files &files, Normalize normalize)
+{
+	load(files, normalize, nullptr, Files());
+}
+
+void Corpus::update(const Corpus &previous, const Files &files, const Files &changed, Normalize normalize)
+{
+	load(files, normalize, &previous, changed);
+}
+
+void Corpus::load(const Files &files, Normalize normalize, const Corpus *previous, const Files &changed)
+{
+	struct Slot {
+		std::uint64_t text, normal;
+		std::size_t bytes, normal_bytes, lines;
+		bool read;
+	};
+	
+	Profiler::Phase read("read files", files.size());
+	bool normalized = normalize != Normalize::none;
+	std::vector<Slot> slots(files.size());
+	
+	// Files that are read are sized up front, so they can be read in place.
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		Slot &slot = slots[i];
+		slot.read = !previous || std::find(begin(changed), end(changed), files[i]) != end(changed);
+		if (slot.read)
+			slot.bytes = files[i]->stat() ? files[i]->m_bytes : 0;
+		else
+			slot.bytes = previous->m_lines[previous->m_files[i + 1]] - previous->m_lines[previous->m_files[i]];
+	}
+	
+	std::uint64_t text = 0, normal = 0;
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		Slot &slot = slots[i];
+		if (text + slot.bytes > s_limit || (normalized && normal + slot.bytes + s_slack > s_limit)) {
+			std::cerr << files[i]->m_path.string() + ": corpus is full\n";
+			slot.bytes = 0;
+			slot.read = true;
+		}
+		
+		slot.text = text;
+		slot.normal = normal;
+		text += slot.bytes;
+		if (normalized) normal += slot.bytes + s_slack;
+	}
+	
+	std::vector<char>(text).swap(m_text);
+	std::vector<char>(normal).swap(m_normal);
+	
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		Slot &slot = slots[i];
+		char *data = m_text.data() + slot.text;
+		if (slot.read) {
+			slot.bytes = read_file(*files[i], data, slot.bytes);
+			slot.lines = std::count(data, data + slot.bytes, '\n') + 1;
+			if (normalized)
+				slot.normal_bytes = normalize_text(data, slot.bytes, m_normal.data() + slot.normal, normalize);
+		} else {
+			std::uint32_t first = previous->m_files[i], last = previous->m_files[i + 1];
+			std::memcpy(data, previous->line(first), slot.bytes);
+			slot.lines = last - first;
+			if (normalized) {
+				slot.normal_bytes = previous->m_keys[last] - previous->m_keys[first];
+				std::memcpy(m_normal.data() + slot.normal, previous->key(first), slot.normal_bytes);
+			}
+		}
+	}
+	
+	// Close the gaps left by files that shrank, and by normalizing.
+	text = normal = 0;
+	m_files.assign(1, 0);
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		Slot &slot = slots[i];
+		std::memmove(m_text.data() + text, m_text.data() + slot.text, slot.bytes);
+		slot.text = text;
+		text += slot.bytes;
+		if (normalized) {
+			std::memmove(m_normal.data() + normal, m_normal.data() + slot.normal, slot.normal_bytes);
+			slot.normal = normal;
+			normal += slot.normal_bytes;
+		}
+		
+		files[i]->m_position = m_files.back();
+		files[i]->m_count = slot.lines;
+		files[i]->m_bytes = slot.bytes;
+		m_files.push_back(m_files.back() + slot.lines);
+	}
+	m_text.resize(text);
+	m_normal.resize(normal);
+	m_normal.shrink_to_fit();
+	
+	read.end();
+	
+	std::size_t lines = m_files.back();
+	Profiler::Phase index("index lines", lines);
+	m_lines.resize(lines + 1);
+	m_keys.resize(normalized ? lines + 1 : 0);
+	m_hashes.resize(lines);
+	m_windows.clear();
+	m_runs = 0;
+	m_stale.assign(files.size(), true);
+	
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		const Slot &slot = slots[i];
+		std::uint32_t first = m_files[i];
+		index_lines(m_text.data() + slot.text, slot.bytes, slot.text, &m_lines[first], slot.lines);
+		if (normalized)
+			index_lines(m_normal.data() + slot.normal, slot.normal_bytes, slot.normal, &m_keys[first], slot.lines);
+		
+		// Line hashes are kept for unchanged files and taken from the cache.
+		std::vector<std::uint64_t> &known = files[i]->m_hashes;
+		if (!slot.read) {
+			std::copy_n(&previous->m_hashes[previous->m_files[i]], slot.lines, &m_hashes[first]);
+			m_stale[i] = false;
+		} else if (known.size() == slot.lines) {
+			std::copy(begin(known), end(known), &m_hashes[first]);
+			m_stale[i] = false;
+		}
+		std::vector<std::uint64_t>().swap(known);
+	}
+	
+	m_lines[lines] = text;
+	if (normalized) m_keys[lines] = normal;
+}
+
+void Corpus::hash(int runs)
+{
+	Profiler::Phase phase("hash lines", size());
+	bool rolled = runs == m_runs;
+	m_windows.resize(size());
+	
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (std::size_t f = 0; f < m_stale.size(); ++f) {
+		if (rolled && !m_stale[f]) continue;
+		std::uint32_t first = m_files[f], last = m_files[f + 1];
+		if (m_stale[f])
+			for (std::uint32_t i = first; i < last; ++i)
+				m_hashes[i] = hash_bytes(key(i), key(i + 1) - key(i));
+		m_stale[f] = false;
+		roll(&m_hashes[first], last - first, runs, &m_windows[first]);
+	}
+	m_runs = runs;
+}
+
+std::vector<std::uint64_t> Corpus::hash_file(SourceFile &file, Normalize normalize, int runs)
+{
+	std::vector<char> text(file.stat() ? file.m_bytes : 0);
+	std::size_t bytes = read_file(file, text.data(), text.size());
+	std::size_t lines = std::count(text.data(), text.data() + bytes, '\n') + 1;
+	file.m_count = lines;
+	file.m_bytes = bytes;
+	
+	if (normalize != Normalize::none) {
+		std::vector<char> normal(bytes + s_slack);
+		normal.resize(normalize_text(text.data(), bytes, normal.data(), normalize));
+		text.swap(normal);
+	} else
+		text.resize(bytes);
+	
+	std::vector<std::uint32_t> offsets(lines + 1);
+	index_lines(text.data(), text.size(), 0, offsets.data(), lines);
+	offsets[lines] = text.size();
+	
+	std::vector<std::uint64_t> hashes(lines);
+	for (std::size_t i = 0; i < lines; ++i)
+		hashes[i] = hash_bytes(text.data() + offsets[i], offsets[i + 1] - offsets[i]);
+	
+	std::vector<std::uint64_t> windows(lines >= std::size_t(runs) ? lines - runs + 1 : 0);
+	roll(hashes.data(), lines, runs, windows.data());
+	return windows;
+}
+
+alg::array_view<std::uint64_t> Corpus::windows(const SourceFile &file, int runs) const
+{
+	std::size_t n = file.line_count() >= std::size_t(runs) ? file.line_count() - runs + 1 : 0;
+	return alg::array_view<std::uint64_t>(m_windows.data() + file.m_position, n);
+}
+
+void Corpus::swap(Corpus &other)
+{
+	m_text.swap(other.m_text);
+	m_normal.swap(other.m_normal);
+	m_lines.swap(other.m_lines);
+	m_keys.swap(other.m_keys);
+	m_files.swap(other.m_files);
+	m_hashes.swap(other.m_hashes);
+	m_windows.swap(other.m_windows);
+	m_stale.swap(other.m_stale);
+	std::swap(m_runs, other.m_runs);
+}
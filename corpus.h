@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "algorithm_ext.h"
+#include "sourcefile.h"
+#include <cstdint>
+#include <vector>
+
+// The text of all files in one buffer. Lines are numbered across files in
+// the order of the walk, so a line number is also a position on the grid.
+// Offsets are 32 bits, which limits a corpus to 4 GiB of text.
+class Corpus
+{
+public:
+	typedef std::vector<SourceFile *> Files;
+	
+	// Reads all files in parallel and sets their positions and line counts.
+	// Failures are reported and leave an empty file.
+	void read(const Files &files, Normalize normalize = Normalize::none);
+	
+	// Like read(), but only the changed files are read again, the others
+	// are copied from previous, which has them at their current positions.
+	void update(const Corpus &previous, const Files &files, const Files &changed, Normalize normalize);
+	
+	// Hashes the lines that are new, and the windows of runs lines that are
+	// new or were rolled for another length.
+	void hash(int runs);
+	
+	// The window hashes of one file on its own, the same as hash() finds
+	// in a corpus, without keeping its text. Sets the line count and size
+	// of the file, not its position.
+	static std::vector<std::uint64_t> hash_file(SourceFile &file, Normalize normalize, int runs);
+	
+	// Writes the normalized text to out, see normalize_text() in corpus.cpp.
+	// It takes at most size + s_slack bytes, for the '\n' of the last line.
+	static const std::size_t s_slack = 1;
+	static std::size_t normalize(const char *data, std::size_t size, char *out, Normalize normalize);
+	
+	bool empty() const { return size() == 0; }
+	std::size_t size() const { return m_lines.empty() ? 0 : m_lines.size() - 1; }
+	const char *line(std::uint32_t i) const { return m_text.data() + m_lines[i]; }
+	
+	// The text lines are compared on, the normalized text when there is one.
+	const char *key(std::uint32_t i) const
+	{ return m_keys.empty() ? line(i) : m_normal.data() + m_keys[i]; }
+	
+	std::uint64_t line_hash(std::uint32_t i) const { return m_hashes[i]; }
+	alg::array_view<std::uint64_t> line_hashes() const { return m_hashes; }
+	alg::array_view<std::uint32_t> borders() const { return m_files; } // First line of every file, and the end
+	std::uint64_t window(std::uint32_t i) const { return m_windows[i]; }
+	alg::array_view<std::uint64_t> hashes(const SourceFile &file) const
+	{ return alg::array_view<std::uint64_t>(m_hashes.data() + file.m_position, file.line_count()); }
+	alg::array_view<std::uint64_t> windows(const SourceFile &file, int runs) const;
+	
+	void swap(Corpus &other);
+	
+private:
+	void load(const Files &files, Normalize normalize, const Corpus *previous, const Files &changed);
+	
+	std::vector<char> m_text;
+	std::vector<char> m_normal;
+	std::vector<std::uint32_t> m_lines;  // Offset of every line in m_text, and the end
+	std::vector<std::uint32_t> m_keys;   // Same for m_normal, when normalized
+	std::vector<std::uint32_t> m_files;  // First line of every file, and the end
+	std::vector<std::uint64_t> m_hashes; // One id per line
+	std::vector<std::uint64_t> m_windows; // Rolling hash of the window starting at a line
+	std::vector<char> m_stale;           // Files whose lines still need hashing
+	int m_runs = 0;                      // Length the windows are rolled for, 0 for none
+};
+
+#endif // CORPUS_H
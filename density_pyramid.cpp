@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "density_pyramid.h"
+
+#include <GL/gl.h>
+#include <cmath>
+#include <numeric>
+#include <parallel/algorithm>
+
+typedef std::pair<std::uint64_t, std::uint64_t> Count;
+
+static inline std::uint64_t key(std::uint32_t x, std::uint32_t y)
+{ return std::uint64_t(x) << 32 | y; }
+
+// Sums the counts of equal cells, which are next to each other, in place.
+static void reduce(std::vector<Count> &counts)
+{
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < counts.size(); ++i)
+		if (n && counts[n - 1].first == counts[i].first)
+			counts[n - 1].second += counts[i].second;
+		else
+			counts[n++] = counts[i];
+	
+	counts.resize(n);
+}
+
+DensityPyramid::~DensityPyramid()
+{
+	release();
+}
+
+void DensityPyramid::release()
+{
+	if (m_uploaded)
+		for (Level &level : m_levels)
+			level.layer.release();
+	
+	m_uploaded = false;
+	m_levels.clear();
+}
+
+// Pairs of a clone class, counted at the start cell of each pair of
+// members. Classes with members in too many cells are binned coarser, each
+// bin counted at the cell of its first member.
+// With a split, only members before it pair with those after.
+static void add_class(const CloneClasses &classes, const CloneClasses::Class &c, int shift, int split, std::vector<Count> &counts)
+{
+	typedef std::vector<std::pair<std::uint32_t, std::uint64_t>> Bins;
+	auto bin = [&] (const std::int32_t *first, const std::int32_t *last, int coarse) {
+		Bins bins;
+		for (const std::int32_t *p = first; p != last; ++p)
+			if (!bins.empty() && (bins.back().first >> (coarse - shift)) == std::uint32_t(*p >> coarse))
+				bins.back().second++;
+			else
+				bins.emplace_back(*p >> shift, 1);
+		return bins;
+	};
+	
+	alg::array_view<std::int32_t> m = classes.members(c);
+	const std::int32_t *middle = split ? std::lower_bound(m.begin(), m.end(), split) : m.end();
+	Bins xs, ys;
+	for (int coarse = shift; coarse < 32; ++coarse) {
+		xs = bin(m.begin(), middle, coarse);
+		ys = split ? bin(middle, m.end(), coarse) : xs;
+		if (std::max(xs.size(), ys.size()) <= 256) break;
+	}
+	
+	for (const auto &a : xs)
+	for (const auto &b : ys)
+		counts.emplace_back(key(a.first, b.first), a.second * b.second * c.length);
+}
+
+void DensityPyramid::build(alg::array_view<Point> points, alg::array_view<Line> lines, int size, const CloneClasses &classes, int split)
+{
+	release();
+	
+	// Points and lines are one half of the grid, counted in both.
+	const int c = 1 << s_base;
+	std::vector<Count> counts;
+	counts.reserve((split ? 1 : 2) * (points.size() + lines.size()));
+	auto add = [&] (int x, int y, std::uint32_t n) {
+		counts.emplace_back(key(x >> s_base, y >> s_base), n);
+		if (!split) counts.emplace_back(key(y >> s_base, x >> s_base), n);
+	};
+	for (const Point &p : points)
+		add(p.first, p.second, 1);
+	
+	// Lines are aligned, walk them cell by cell.
+	for (const Line &l : lines) {
+		int x = l.first.first, y = l.first.second, n = l.second.second - y + 1;
+		while (n > 0) {
+			int m = std::min({n, c - (x & (c - 1)), c - (y & (c - 1))});
+			add(x, y, m);
+			x += m; y += m; n -= m;
+		}
+	}
+	
+	// Classes once, their bins are as coarse on every level up to the one
+	// where they fit, so the counts carry up with those of the points.
+	for (const CloneClasses::Class &c : classes.classes())
+		add_class(classes, c, s_base, split, counts);
+	
+	// Sorted once, by key: by column, then by row.
+	__gnu_parallel::sort(begin(counts), end(counts));
+	reduce(counts);
+	
+	std::vector<std::size_t> order, rows;
+	std::vector<Count> next;
+	for (int shift = s_base; ; ++shift) {
+		// Columns of blocks are together, within one the cells go to their
+		// block by a counting sort, which keeps them in key order.
+		order.resize(counts.size());
+		for (std::size_t i = 0, j; i < counts.size(); i = j) {
+			std::uint32_t column = counts[i].first >> 32 >> s_block;
+			for (j = i; j < counts.size() && counts[j].first >> 32 >> s_block == column; ++j);
+			
+			rows.assign(1, 0);
+			for (std::size_t k = i; k < j; ++k) {
+				std::size_t row = (counts[k].first & 0xffffffff) >> s_block;
+				if (row + 2 > rows.size()) rows.resize(row + 2);
+				rows[row + 1]++;
+			}
+			std::partial_sum(begin(rows), end(rows), begin(rows));
+			for (std::size_t k = i; k < j; ++k)
+				order[i + rows[(counts[k].first & 0xffffffff) >> s_block]++] = k;
+		}
+		
+		Level level;
+		level.shift = shift;
+		level.cells.reserve(counts.size());
+		float cell = std::ldexp(1.f, shift);
+		const std::uint32_t mask = (1 << s_block) - 1;
+		auto block = [] (const Count &c) { return key(c.first >> 32 >> s_block, (c.first & 0xffffffff) >> s_block); };
+		for (std::size_t i : order) {
+			const Count &count = counts[i];
+			if (level.blocks.empty() || level.blocks.back().key != block(count))
+				level.blocks.push_back(Block{block(count), level.cells.size()});
+			
+			// A full diagonal through a cell is as bright as it gets.
+			unsigned char a = 255 * std::min(1.f, std::sqrt(count.second / cell));
+			level.cells.push_back(Cell{
+				((count.first >> 32) & mask) * cell + cell / 2,
+				(count.first & mask) * cell + cell / 2,
+				{255, 255, 255, a}
+			});
+		}
+		level.blocks.push_back(Block{~std::uint64_t(0), level.cells.size()});
+		m_levels.push_back(std::move(level));
+		
+		if ((std::int64_t(1) << shift) >= size || counts.empty()) break;
+		
+		// Two columns become one, both still sorted by row, so merging them
+		// keeps the counts sorted.
+		next.clear();
+		for (std::size_t i = 0, j, k; i < counts.size(); i = k) {
+			std::uint64_t column = counts[i].first >> 33;
+			for (j = i; j < counts.size() && counts[j].first >> 32 == column << 1; ++j);
+			for (k = j; k < counts.size() && counts[k].first >> 33 == column; ++k);
+			for (std::size_t l = i; l < k; ++l)
+				counts[l].first = key(column, (counts[l].first & 0xffffffff) >> 1);
+			std::merge(begin(counts) + i, begin(counts) + j, begin(counts) + j, begin(counts) + k, std::back_inserter(next),
+				[] (const Count &a, const Count &b) { return a.first < b.first; });
+		}
+		counts.swap(next);
+		reduce(counts);
+	}
+}
+
+void DensityPyramid::setup()
+{
+	for (Level &level : m_levels) {
+		level.layer.upload(level.cells);
+		level.cells = std::vector<Cell>();
+	}
+	
+	m_uploaded = true;
+}
+
+bool DensityPyramid::draw(double scale, double x0, double y0, double x1, double y1)
+{
+	if (!m_uploaded || m_levels.empty() || scale * (1 << s_base) >= 1) return false;
+	
+	// The smallest cells that still cover at least one pixel.
+	std::size_t i = std::ceil(std::log2(1 / scale)) - s_base;
+	i = std::min(i, m_levels.size() - 1);
+	const Level &level = m_levels[i];
+	
+	Renderer::point_size(std::ldexp(1., level.shift));
+	Renderer::color(1, 1, 1, 1);
+	
+	// Only blocks on screen, each offset relative to the view.
+	double block = std::ldexp(1., level.shift + s_block), px = (x0 + x1) / 2, py = (y0 + y1) / 2;
+	std::uint32_t bx0 = std::max(0., std::floor(x0 / block)), bx1 = std::max(0., std::floor(x1 / block));
+	std::uint32_t by0 = std::max(0., std::floor(y0 / block)), by1 = std::max(0., std::floor(y1 / block));
+	auto less = [] (const Block &b, std::uint64_t key) { return b.key < key; };
+	auto last = end(level.blocks) - 1;
+	for (std::uint64_t bx = bx0; bx <= bx1; ++bx) {
+		auto a = std::lower_bound(begin(level.blocks), last, key(bx, by0), less);
+		auto e = std::lower_bound(a, last, key(bx, by1) + 1, less);
+		for (; a != e; ++a) {
+			Renderer::offset(bx * block - px, (a->key & 0xffffffff) * block - py);
+			level.layer.draw(GL_POINTS, a->first, (a + 1)->first - a->first);
+		}
+	}
+	
+	Renderer::point_size(1);
+	
+	return true;
+}
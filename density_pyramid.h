@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DENSITY_PYRAMID_H
+#define DENSITY_PYRAMID_H
+
+#include "algorithm_ext.h"
+#include "clone_classes.h"
+#include "renderer.h"
+#include <cstdint>
+#include <vector>
+
+// Clone density at cell sizes of 4, 8, 16, ... lines, used instead of the
+// raw points and lines once many lines share a pixel.
+class DensityPyramid
+{
+public:
+	typedef std::pair<std::int32_t, std::int32_t> Point;
+	typedef std::pair<Point, Point> Line;
+	
+	~DensityPyramid();
+	
+	// Points and lines above the diagonal, shown on both sides of it. With a
+	// split, only the pairs of a line before it and one after it.
+	void build(alg::array_view<Point> points, alg::array_view<Line> lines, int size, const CloneClasses &classes, int split);
+	void setup();
+	
+	// Returns false when zoomed in far enough to draw the raw points. The
+	// box is what is on screen, centered on the view.
+	bool draw(double scale, double x0, double y0, double x1, double y1);
+	
+private:
+	static const int s_base = 2;
+	static const int s_block = 16; // Blocks of 2^16 x 2^16 cells
+	
+	// Centered in its cell, relative to the origin of its block.
+	struct Cell {
+		float x, y;
+		unsigned char color[4];
+	};
+	
+	// Key of every non-empty block and its first cell, with a sentinel.
+	struct Block {
+		std::uint64_t key;
+		std::size_t first;
+	};
+	
+	struct Level {
+		std::vector<Cell> cells;
+		std::vector<Block> blocks;
+		int shift;
+		Renderer::Layer layer{Renderer::Layout::colored};
+	};
+	
+	std::vector<Level> m_levels;
+	bool m_uploaded = false;
+	
+	void release();
+};
+
+#endif // DENSITY_PYRAMID_H
@@ -25,11 +25,14 @@
 
 
 #include "environment_2d.h"
+#include "profiler.h"
+#include "renderer.h"
 
-#include <GL/glut.h>
+#include <GL/freeglut.h>
 #include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <cmath>
 
 // #define PRINT_DURATION
 
@@ -47,6 +50,8 @@ static int s_translate_y;
 static int s_window_width  = 800;
 static int s_window_height = 800;
 
+static Renderer::Layer s_crosshair(Renderer::Layout::points);
+
 static void reset()
 {
 	s_translate_x = s_translate_y = - s_drawable->size() / 2;
@@ -62,11 +67,6 @@ static void reshape(int width, int height)
 	s_window_height = height = (height + 1) / 2 * 2;
 	
 	glViewport(0, 0, width, height);
-	
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluOrtho2D(- width / 2, width / 2, - height / 2, height / 2);
-	glMatrixMode(GL_MODELVIEW);
 }
 
 static void display()
@@ -76,46 +76,36 @@ static void display()
 	typedef std::chrono::microseconds microseconds;
 	Clock::time_point t0 = Clock::now();
 #endif
+	Profiler::Phase phase("frame");
 	
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	glLoadIdentity();
-	glTranslated(.5, .5, 0);
-	
-	glPushMatrix();
-		glScalef(s_scale, s_scale, 0);
-
-		glPushMatrix();
-			glTranslated(s_translate_x, s_translate_y, 0);
-			s_drawable->draw(s_scale,
-				s_window_width, s_window_height,
-				-s_translate_x, -s_translate_y
-			);
-		glPopMatrix();
-
-		if (s_scale > 1/3.) {
-			glBegin(GL_LINE_STRIP);
-			glColor4f(0, 1, 1, .6 * sqrt(std::max(.0, 1.5 * s_scale - .5)));
-			glVertex2i(-20, -20); glVertex2i( 20, -20);
-			glVertex2i( 20,  20); glVertex2i(-20,  20);
-			glVertex2i(-20, -20);
-			glEnd();
-		}
-	glPopMatrix();
-
-
-	glBegin(GL_LINES);
-
-	glColor4f(0, 1, 1, .6);
-	glVertex2i(-20, 0); glVertex2i(20, 0);
-	glVertex2i(0, -20); glVertex2i(0, 20);
-
-	glColor4f(0, 1, 1, .2);
-	glVertex2i(- s_window_width / 2, 0); glVertex2i(s_window_width / 2, 0);
-	glVertex2i(0, - s_window_height / 2); glVertex2i(0, s_window_height / 2);
-
-	glEnd();
+	s_drawable->draw(s_scale,
+		s_window_width, s_window_height,
+		-s_translate_x, -s_translate_y
+	);
 
+	// The box around the center, in lines, then the crosshair in pixels:
+	float w = s_window_width / 2, h = s_window_height / 2;
+	std::vector<Renderer::Vertex> vertices = {
+		{-20, -20}, { 20, -20}, { 20,  20}, {-20,  20}, {-20, -20},
+		{-20,   0}, { 20,   0}, {  0, -20}, {  0,  20},
+		{ -w,   0}, {  w,   0}, {  0,  -h}, {  0,   h},
+	};
+	s_crosshair.upload(vertices, true);
+	Renderer::offset(0, 0);
+	
+	if (s_scale > 1/3.) {
+		Renderer::view(s_scale, s_window_width, s_window_height);
+		Renderer::color(0, 1, 1, .6 * sqrt(std::max(.0, 1.5 * s_scale - .5)));
+		s_crosshair.draw(GL_LINE_STRIP, 0, 5);
+	}
+	
+	Renderer::view(1, s_window_width, s_window_height);
+	Renderer::color(0, 1, 1, .6);
+	s_crosshair.draw(GL_LINES, 5, 4);
+	Renderer::color(0, 1, 1, .2);
+	s_crosshair.draw(GL_LINES, 9, 4);
 
 	glutSwapBuffers();
 	
@@ -151,6 +141,18 @@ static void special(int k, int x, int y)
 	glutPostRedisplay();
 }
 
+static void timer(int value)
+{
+	// The view fits the drawable once it has a size, e.g. after loading.
+	bool sized = s_drawable->size() > 0;
+	if (s_drawable->update()) {
+		if (!sized) reset();
+		glutPostRedisplay();
+	}
+	
+	glutTimerFunc(250, timer, value);
+}
+
 static int s_old_x, s_old_y;
 
 static void mouse(int button, int state, int x, int y)
@@ -196,6 +198,8 @@ void Environment2D::start()
 	reset();
 	
 	glutInitDisplayMode(GLUT_RGBA|GLUT_DOUBLE|GLUT_ALPHA);
+	glutInitContextVersion(3, 3);
+	glutInitContextProfile(GLUT_CORE_PROFILE);
 	
 	glutInitWindowPosition(100, 100);
 	glutInitWindowSize(s_window_width, s_window_height);
@@ -204,6 +208,7 @@ void Environment2D::start()
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glClearColor(0,0,0,0);
+	Renderer::setup();
 
 	glutReshapeFunc(reshape);
 	glutDisplayFunc(display);
@@ -211,6 +216,7 @@ void Environment2D::start()
 	glutSpecialFunc(special);
 	glutMouseFunc(mouse);
 	glutMotionFunc(motion);
+	glutTimerFunc(250, timer, 0);
 
 	s_drawable->setup();
 	
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <parallel/algorithm>
+#include <queue>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Sorts more elements than fit in memory. Elements fill a buffer of about
+// budget bytes, every full buffer is sorted and written out as a run, and
+// merge() merges the runs while reading them back, in several passes when
+// there are too many to read at once. All runs go into one temporary file,
+// which is unlinked as soon as it is created. Elements are written as
+// their bytes, so they can't own memory.
+template<typename T>
+class ExternalSort
+{
+public:
+	explicit ExternalSort(std::size_t budget)
+		: m_capacity(std::max(budget / sizeof(T), 2 * s_block)) {}
+	~ExternalSort() { if (m_fd >= 0) ::close(m_fd); }
+	
+	ExternalSort(const ExternalSort &) = delete;
+	ExternalSort &operator=(const ExternalSort &) = delete;
+	
+	void push(const T &value)
+	{
+		if (m_buffer.size() == m_capacity) spill();
+		if (m_buffer.capacity() < m_capacity) m_buffer.reserve(m_capacity);
+		m_buffer.push_back(value);
+		m_size++;
+	}
+	
+	std::size_t size() const { return m_size; }
+	
+	// Calls f for every element in order, once. Returns false when the
+	// temporary file could not be written or read.
+	template<typename F>
+	bool merge(F f)
+	{
+		if (m_runs.empty()) {
+			__gnu_parallel::sort(begin(m_buffer), end(m_buffer));
+			for (const T &value : m_buffer) f(value);
+			std::vector<T>().swap(m_buffer);
+			return !m_failed;
+		}
+		
+		spill();
+		std::vector<T>().swap(m_buffer);
+		
+		// Every run needs a block of its own, and a pass writes one too.
+		const std::size_t inputs = std::max<std::size_t>(2, m_capacity / s_block - 1);
+		while (m_runs.size() > inputs && !m_failed) {
+			Run run{m_end, 0};
+			std::vector<T> out;
+			out.reserve(s_block);
+			merge(0, inputs, [&] (const T &value) {
+				out.push_back(value);
+				if (out.size() == s_block) {
+					write(out);
+					out.clear();
+				}
+			});
+			write(out);
+			run.size = m_end - run.first;
+			m_runs.erase(begin(m_runs), begin(m_runs) + inputs);
+			m_runs.push_back(run);
+		}
+		
+		if (!m_failed) merge(0, m_runs.size(), f);
+		return !m_failed;
+	}
+	
+private:
+	static const std::size_t s_block = 1 << 12; // Elements, the least read from a run at once
+	
+	struct Run {
+		std::uint64_t first, size; // In elements
+	};
+	
+	std::size_t m_capacity;
+	std::vector<T> m_buffer;
+	std::vector<Run> m_runs;
+	std::size_t m_size = 0;
+	std::uint64_t m_end = 0; // Elements in the file
+	int m_fd = -1;
+	bool m_failed = false;
+	
+	void spill()
+	{
+		if (m_buffer.empty()) return;
+		__gnu_parallel::sort(begin(m_buffer), end(m_buffer));
+		m_runs.push_back(Run{m_end, m_buffer.size()});
+		write(m_buffer);
+		m_buffer.clear();
+	}
+	
+	void write(const std::vector<T> &values)
+	{
+		if (m_fd < 0 && !m_failed) {
+			boost::system::error_code error;
+			boost::filesystem::path path = boost::filesystem::temp_directory_path(error) /
+				boost::filesystem::unique_path("clonegrid-%%%%-%%%%-%%%%.tmp");
+			m_fd = error ? -1 : ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+			if (m_fd >= 0) ::unlink(path.c_str());
+		}
+		
+		const char *data = reinterpret_cast<const char *>(values.data());
+		std::size_t size = values.size() * sizeof(T), done = 0;
+		while (m_fd >= 0 && done < size) {
+			ssize_t n = ::pwrite(m_fd, data + done, size - done, m_end * sizeof(T) + done);
+			if (n <= 0) break;
+			done += n;
+		}
+		m_failed |= done < size;
+		m_end += values.size();
+	}
+	
+	bool read(std::vector<T> &values, std::uint64_t first)
+	{
+		char *data = reinterpret_cast<char *>(values.data());
+		std::size_t size = values.size() * sizeof(T), done = 0;
+		while (done < size) {
+			ssize_t n = ::pread(m_fd, data + done, size - done, first * sizeof(T) + done);
+			if (n <= 0) break;
+			done += n;
+		}
+		m_failed |= done < size;
+		return done == size;
+	}
+	
+	// Merges the runs [first, last) with a heap of the next element of each.
+	template<typename F>
+	void merge(std::size_t first, std::size_t last, F f)
+	{
+		struct Input {
+			std::vector<T> values;
+			std::size_t next;
+			std::uint64_t offset, left;
+		};
+		
+		const std::size_t block = std::max(s_block, m_capacity / (last - first + 1));
+		std::vector<Input> inputs(last - first);
+		auto fill = [&] (Input &in) {
+			in.values.resize(std::min<std::uint64_t>(block, in.left));
+			in.next = 0;
+			if (!read(in.values, in.offset)) return false;
+			in.offset += in.values.size();
+			in.left -= in.values.size();
+			return true;
+		};
+		
+		typedef std::pair<T, std::size_t> Head;
+		auto later = [] (const Head &a, const Head &b) { return b.first < a.first; };
+		std::priority_queue<Head, std::vector<Head>, decltype(later)> heap(later);
+		for (std::size_t i = 0; i < inputs.size(); ++i) {
+			inputs[i].offset = m_runs[first + i].first;
+			inputs[i].left = m_runs[first + i].size;
+			if (!fill(inputs[i])) return;
+			heap.emplace(inputs[i].values[0], i);
+		}
+		
+		while (!heap.empty()) {
+			Head head = heap.top();
+			heap.pop();
+			f(head.first);
+			
+			Input &in = inputs[head.second];
+			if (++in.next == in.values.size()) {
+				if (!in.left) continue;
+				if (!fill(in)) return;
+			}
+			heap.emplace(in.values[in.next], head.second);
+		}
+	}
+};
+
+#endif // EXTERNAL_SORT_H
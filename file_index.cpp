@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "file_index.h"
+
+#include <algorithm>
+
+void FileIndex::build(const Files &files, int size)
+{
+	m_files = files;
+	m_size = size;
+	m_first.assign(files.size() + 1, 0);
+	m_order.assign(files.size() + 1, 0);
+	std::size_t i = 0;
+	fill(1, i);
+}
+
+// In order, so the nodes of a subtree are a range of files.
+void FileIndex::fill(std::size_t node, std::size_t &i)
+{
+	if (node >= m_first.size()) return;
+	fill(2 * node, i);
+	m_first[node] = m_files[i]->m_position;
+	m_order[node] = i++;
+	fill(2 * node + 1, i);
+}
+
+FileIndex::Location FileIndex::locate(int position) const
+{
+	if (position < 0 || position >= m_size) return Location{nullptr, 0};
+	
+	// Down to the first file that starts after position, the one before it
+	// has it. Empty files start where the next one does, so they are skipped.
+	std::size_t node = 1, n = m_first.size();
+	while (node < n) {
+		__builtin_prefetch(m_first.data() + std::min(16 * node, n - 1));
+		node = 2 * node + (m_first[node] <= position);
+	}
+	node >>= __builtin_ffsl(~node);
+	
+	SourceFile *file = m_files[(node ? m_order[node] : m_files.size()) - 1];
+	return Location{file, position - file->m_position};
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include "sourcefile.h"
+#include <vector>
+
+// Finds the file of a line position. The first lines of the files are kept
+// in Eytzinger order, the layout of a binary heap, so the top of the search
+// shares a few cache lines and the rest is fetched ahead.
+class FileIndex
+{
+public:
+	typedef std::vector<SourceFile *> Files;
+	
+	struct Location {
+		SourceFile *file; // nullptr outside the grid
+		int line;         // Within the file, from 0
+	};
+	
+	// Files in the order of their positions, size is the total of lines.
+	void build(const Files &files, int size);
+	
+	SourceFile *file(int position) const { return locate(position).file; }
+	Location locate(int position) const;
+	
+private:
+	Files m_files;
+	std::vector<int> m_first; // First lines, from 1 in Eytzinger order
+	std::vector<int> m_order; // Index in m_files of every node
+	int m_size = 0;
+	
+	void fill(std::size_t node, std::size_t &i);
+};
+
+#endif // FILE_INDEX_H
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "generator.h"
+
+#include <boost/format.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+std::size_t Generator::write(const fs::path &root) const
+{
+	// Only the engine is fixed by the standard, so draw numbers by hand.
+	std::mt19937 engine(m_seed);
+	auto random = [&] (int lo, int hi) { return lo + int(engine() % std::uint32_t(hi - lo + 1)); };
+	
+	std::vector<int> sizes(m_files);
+	std::size_t total = 0;
+	for (int &size : sizes)
+		total += size = random(m_lines / 2, m_lines * 3 / 2);
+	
+	// Fragments are at least a window long and are placed in random files,
+	// until the cloned lines make up the requested share.
+	int shortest = std::max(4, m_fragment / 2), longest = std::max(shortest, m_fragment);
+	std::vector<int> lengths;
+	std::vector<std::vector<int>> placed(m_files);
+	std::size_t cloned = 0, copies = 0;
+	while (m_files > 0 && m_density < 1 && cloned < m_density * (total + cloned)) {
+		int length = random(shortest, longest), n = random(2, std::max(2, m_group));
+		for (int i = 0; i < n; ++i)
+			placed[random(0, m_files - 1)].push_back(lengths.size());
+		lengths.push_back(length);
+		cloned += std::size_t(length) * n;
+		copies += n;
+	}
+	
+	// Every other line is unique, so only the fragments are clones.
+	std::size_t unique = 0;
+	for (int i = 0; i < m_files; ++i) {
+		fs::path dir = root / (boost::format("%03d") % (i / 100)).str();
+		fs::create_directories(dir);
+		std::ofstream out((dir / (boost::format("%05d.cpp") % i).str()).string());
+		
+		std::vector<std::pair<int, int>> at; // Unique lines before, fragment
+		for (int fragment : placed[i])
+			at.emplace_back(random(0, sizes[i]), fragment);
+		std::sort(begin(at), end(at));
+		
+		auto next = begin(at);
+		for (int line = 0; line <= sizes[i]; ++line) {
+			for (; next != end(at) && next->first == line; ++next)
+				for (int k = 0; k < lengths[next->second]; ++k)
+					out << boost::format("\tfragment_%d(%d);\n") % next->second % k;
+			if (line < sizes[i])
+				out << boost::format("\tint v%d = w(%d);\n") % unique++ % line;
+		}
+	}
+	
+	std::cout << boost::format("Generated:   %d files, %d lines, %d fragments in %d copies\n")
+		% m_files % (unique + cloned) % lengths.size() % copies;
+	return unique + cloned;
+}
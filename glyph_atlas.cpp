@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "glyph_atlas.h"
+
+#include <GL/gl.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <algorithm>
+
+// Decodes one UTF-8 sequence, invalid bytes stand for themselves.
+static std::uint32_t decode(const char *&p, const char *last)
+{
+	unsigned char c = *p++;
+	int n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+	if (n == 0 || last - p < n) return c;
+	
+	std::uint32_t code = c & (0x3f >> n);
+	for (int i = 0; i < n; ++i) {
+		if ((p[i] & 0xc0) != 0x80) return c;
+		code = code << 6 | (p[i] & 0x3f);
+	}
+	p += n;
+	return code;
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+	if (m_texture) glDeleteTextures(1, &m_texture);
+	if (m_face) FT_Done_Face(m_face);
+	if (m_library) FT_Done_FreeType(m_library);
+}
+
+bool GlyphAtlas::load(const std::vector<std::string> &paths, int size)
+{
+	if (!m_library && FT_Init_FreeType(&m_library) != 0) return false;
+	for (const std::string &path : paths)
+		if (!m_face && FT_New_Face(m_library, path.c_str(), 0, &m_face) != 0)
+			m_face = nullptr;
+	if (!m_face) return false;
+	
+	FT_Set_Pixel_Sizes(m_face, 0, size);
+	m_size = size;
+	m_line_height = m_face->size->metrics.height >> 6;
+	m_pixels.assign(s_width * s_width, 0);
+	
+	// Control characters show as a question mark.
+	m_ascii.assign(128, Glyph{0, 0, 0, 0, 0, 0, 0, 0, 0});
+	for (std::uint32_t code = ' '; code < 127; ++code)
+		render(code, m_ascii[code]);
+	for (std::uint32_t code = 0; code < 128; ++code)
+		if (code < ' ' || code == 127) m_ascii[code] = m_ascii['?'];
+	return true;
+}
+
+const GlyphAtlas::Glyph &GlyphAtlas::glyph(std::uint32_t code)
+{
+	if (code < m_ascii.size()) return m_ascii[code];
+	
+	auto it = m_glyphs.find(code);
+	if (it != m_glyphs.end()) return it->second;
+	
+	// Also when the texture is full.
+	Glyph glyph;
+	if (!render(code, glyph)) glyph = m_ascii['?'];
+	return m_glyphs[code] = glyph;
+}
+
+bool GlyphAtlas::render(std::uint32_t code, Glyph &glyph)
+{
+	if (FT_Load_Char(m_face, code, FT_LOAD_RENDER) != 0) return false;
+	
+	FT_GlyphSlot slot = m_face->glyph;
+	const FT_Bitmap &bitmap = slot->bitmap;
+	int width = bitmap.width, height = bitmap.rows;
+	if (m_x + width + 1 > s_width) {
+		m_x = 0;
+		m_y += m_row + 1;
+		m_row = 0;
+	}
+	if (m_y + height + 1 > s_width) return false;
+	
+	for (int row = 0; row < height; ++row)
+		std::copy_n(bitmap.buffer + row * bitmap.pitch, width, &m_pixels[(m_y + row) * s_width + m_x]);
+	
+	glyph.x0 = slot->bitmap_left;
+	glyph.x1 = glyph.x0 + width;
+	glyph.y1 = slot->bitmap_top;
+	glyph.y0 = glyph.y1 - height;
+	glyph.advance = slot->advance.x >> 6;
+	glyph.u0 = float(m_x) / s_width;
+	glyph.v0 = float(m_y) / s_width;
+	glyph.u1 = float(m_x + width) / s_width;
+	glyph.v1 = float(m_y + height) / s_width;
+	
+	m_x += width + 1;
+	m_row = std::max(m_row, height);
+	m_dirty = true;
+	return true;
+}
+
+void GlyphAtlas::text(const char *first, const char *last, int x, int y, const unsigned char color[4], std::vector<Vertex> &out)
+{
+	if (!m_face) return;
+	
+	auto vertex = [&] (float x, float y, float u, float v) {
+		out.push_back(Vertex{x, y, u, v, {color[0], color[1], color[2], color[3]}});
+	};
+	
+	for (const char *p = first; p != last && *p != '\n'; ) {
+		std::uint32_t code = decode(p, last);
+		if (code == '\r') continue;
+		if (code == '\t') {
+			x += 4 * m_ascii[' '].advance;
+			continue;
+		}
+		
+		const Glyph &g = glyph(code);
+		if (g.x0 != g.x1) {
+			vertex(x + g.x0, y + g.y0, g.u0, g.v1);
+			vertex(x + g.x1, y + g.y0, g.u1, g.v1);
+			vertex(x + g.x1, y + g.y1, g.u1, g.v0);
+			vertex(x + g.x0, y + g.y0, g.u0, g.v1);
+			vertex(x + g.x1, y + g.y1, g.u1, g.v0);
+			vertex(x + g.x0, y + g.y1, g.u0, g.v0);
+		}
+		x += g.advance;
+	}
+}
+
+void GlyphAtlas::draw(const Renderer::Layer &layer, std::size_t vertices)
+{
+	if (!m_face || vertices == 0) return;
+	
+	if (!m_texture) {
+		glGenTextures(1, &m_texture);
+		glBindTexture(GL_TEXTURE_2D, m_texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		m_dirty = true;
+	}
+	
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	if (m_dirty) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, s_width, s_width, 0, GL_RED, GL_UNSIGNED_BYTE, m_pixels.data());
+		m_dirty = false;
+	}
+	
+	// Glyph coverage times the color of the vertex, see Renderer.
+	Renderer::color(1, 1, 1, 1);
+	layer.draw(GL_TRIANGLES, 0, vertices);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include "renderer.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+// The glyphs of one font, rendered once into a single texture, the first
+// time they are used. Text is laid out as two triangles per glyph, so any
+// amount of it is drawn in one call.
+class GlyphAtlas
+{
+public:
+	struct Vertex {
+		float x, y, u, v;
+		unsigned char color[4];
+	};
+	
+	~GlyphAtlas();
+	
+	// Loads the first font that opens, false when none does.
+	bool load(const std::vector<std::string> &paths, int size);
+	int size() const { return m_size; }
+	int line_height() const { return m_line_height; }
+	
+	// Appends the triangles of [first, last) up to a newline, with the baseline
+	// starting at (x, y). Tabs are four spaces, carriage returns are skipped.
+	void text(const char *first, const char *last, int x, int y, const unsigned char color[4], std::vector<Vertex> &out);
+	
+	// Draws a glyphs layer, after uploading new glyphs.
+	void draw(const Renderer::Layer &layer, std::size_t vertices);
+	
+private:
+	static const int s_width = 512; // Texture of s_width x s_width
+	
+	// Offsets from the pen on the baseline, and texture coordinates.
+	struct Glyph {
+		short x0, y0, x1, y1, advance;
+		float u0, v0, u1, v1;
+	};
+	
+	const Glyph &glyph(std::uint32_t code);
+	bool render(std::uint32_t code, Glyph &glyph);
+	
+	FT_LibraryRec_ *m_library = nullptr;
+	FT_FaceRec_ *m_face = nullptr;
+	int m_size = 0, m_line_height = 0;
+	
+	std::vector<Glyph> m_ascii; // Printable ASCII, by code
+	std::unordered_map<std::uint32_t, Glyph> m_glyphs;
+	
+	// Glyphs are packed in rows, the texture is uploaded when it changed.
+	std::vector<unsigned char> m_pixels;
+	int m_x = 0, m_y = 0, m_row = 0;
+	unsigned int m_texture = 0;
+	bool m_dirty = false;
+};
+
+#endif // GLYPH_ATLAS_H
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "hash_detector.h"
+#include "algorithm_ext.h"
+#include "corpus.h"
+#include "profiler.h"
+
+#include <parallel/algorithm>
+
+namespace {
+
+struct Window {
+	std::uint64_t hash;
+	std::uint32_t line;
+	
+	bool operator<(const Window &w) const
+	{ return hash < w.hash || (hash == w.hash && line < w.line); }
+};
+
+}
+
+void HashDetector::detect(Corpus &corpus, Lines &lines, int runs, const Group &group)
+{
+	corpus.hash(runs);
+	
+	Profiler::Phase sort("sort windows", lines.size());
+	std::vector<Window> windows(lines.size());
+	#pragma omp parallel for
+	for (std::size_t i = 0; i < lines.size(); ++i)
+		windows[i] = Window{corpus.window(lines[i]), lines[i]};
+	
+	__gnu_parallel::sort(begin(windows), end(windows));
+	
+	#pragma omp parallel for
+	for (std::size_t i = 0; i < lines.size(); ++i)
+		lines[i] = windows[i].line;
+	sort.end();
+	
+	Profiler::Phase phase("group windows", lines.size());
+	for (std::size_t i = 0, j; i < windows.size(); i = j) {
+		for (j = i + 1; j < windows.size() && windows[j].hash == windows[i].hash; ++j);
+		if (j - i >= 2) verify(corpus, begin(lines) + i, begin(lines) + j, runs, group);
+	}
+}
+
+void HashDetector::verify(const Corpus &corpus, Lines::iterator first, Lines::iterator last, int runs, const Group &group)
+{
+	auto less = [&] (std::uint32_t a, std::uint32_t b) {
+		return std::lexicographical_compare(corpus.key(a), corpus.key(a + runs), corpus.key(b), corpus.key(b + runs));
+	};
+	auto equal = [&] (std::uint32_t a, std::uint32_t b) {
+		return alg::equal(corpus.key(a), corpus.key(a + runs), corpus.key(b), corpus.key(b + runs));
+	};
+	
+	// Usually all windows are equal, a collision splits them up further.
+	if (std::all_of(first + 1, last, [&] (std::uint32_t l) { return equal(*first, l); })) {
+		group(first, last - 1);
+		return;
+	}
+	
+	std::sort(first, last, less);
+	alg::process_adjacent(first, last, equal,
+		[] (Lines::iterator, Lines::iterator) {}, group
+	);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef IDETECTOR_H
+#define IDETECTOR_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class Corpus;
+
+class IDetector
+{
+public:
+	typedef std::vector<std::uint32_t> Lines; // First lines of windows
+	
+	// Called for every group of identical windows, [first, last] inclusive.
+	typedef std::function<void(Lines::iterator first, Lines::iterator last)> Group;
+	
+	// Called for every maximal run of pairs: the windows at a + i and b + i
+	// are in one group of fewer than pairs windows, for all i < length, or
+	// alike when the detector isn't exact(). Only with a < b, the mirrored
+	// runs are implied.
+	typedef std::function<void(std::uint32_t a, std::uint32_t b, std::uint32_t length)> Run;
+	
+	virtual const char *name() const = 0;
+	virtual bool exact() const { return true; } // Only identical windows pair up
+	virtual void detect(Corpus &corpus, Lines &lines, int runs, const Group &group) = 0;
+	
+	// Like detect(), but the pairs of small groups come as runs instead.
+	// Returns false, without calling anything, when the detector can't.
+	virtual bool detect_runs(Corpus &, Lines &, int /*runs*/, int /*pairs*/, const Group &, const Run &)
+	{ return false; }
+	
+	virtual ~IDetector() {}
+};
+
+#endif // IDETECTOR_H
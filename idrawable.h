@@ -31,8 +31,12 @@ class IDrawable
 {
 public:
 	virtual void setup() = 0;
+	
+	// Drawn scaled, centered on (px, py). The drawable translates itself,
+	// so large coordinates can be drawn relative to the view.
 	virtual void draw(double scale, int width, int height, int px, int py) = 0;
 	virtual double size() = 0;
+	virtual bool update() { return false; } // Polled, true to redraw
 	virtual ~IDrawable() {}
 };
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "index_cache.h"
+#include "corpus.h"
+#include "sourcefile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+const char IndexCache::s_magic[8] = {'C', 'L', 'O', 'N', 'E', 'I', 'D', 'X'};
+
+IndexCache::~IndexCache()
+{
+	close();
+}
+
+void IndexCache::close()
+{
+	if (m_data) ::munmap(m_data, m_size);
+	m_data = nullptr;
+	m_size = 0;
+	m_index.clear();
+}
+
+template<typename T>
+static bool section(alg::array_view<T> &view, const char *&it, const char *last, std::uint64_t n)
+{
+	if (std::uint64_t(last - it) / sizeof(T) < n) return false;
+	view = alg::array_view<T>(reinterpret_cast<const T *>(it), n);
+	it += n * sizeof(T);
+	return true;
+}
+
+bool IndexCache::open(const fs::path &path, int runs, Normalize normalize, bool compare, bool exact)
+{
+	close();
+	
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	
+	struct stat st;
+	if (::fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(Header)) {
+		m_size = st.st_size;
+		m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m_data == MAP_FAILED) m_data = nullptr;
+	}
+	::close(fd);
+	if (!m_data) return false;
+	
+	const Header &header = *static_cast<const Header *>(m_data);
+	const char *it = static_cast<const char *>(m_data) + sizeof(Header);
+	const char *last = static_cast<const char *>(m_data) + m_size;
+	alg::array_view<char> names;
+	
+	if (
+		std::memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 ||
+		header.version != s_version || header.runs != runs ||
+		header.normalize != int(normalize) || header.compare != int(compare) || header.exact != int(exact) ||
+		!section(m_entries, it, last, header.files) ||
+		!section(m_hashes, it, last, header.hashes) ||
+		!section(m_vertices, it, last, header.vertices) ||
+		!section(m_vlines, it, last, header.vlines) ||
+		!section(m_classes, it, last, header.classes) ||
+		!section(m_class_members, it, last, header.class_members) ||
+		!section(names, it, last, header.names)
+	) {
+		std::cerr << "Ignoring incompatible cache " << path << "\n";
+		close();
+		return false;
+	}
+	
+	m_names = names.data();
+	for (const Entry &entry : m_entries)
+		if (entry.name + entry.name_size > names.size() || entry.hash + entry.lines > m_hashes.size()) {
+			std::cerr << "Ignoring corrupt cache " << path << "\n";
+			close();
+			return false;
+		}
+	
+	for (const CloneClasses::Class &c : m_classes)
+		if (c.first + c.size > m_class_members.size()) {
+			std::cerr << "Ignoring corrupt cache " << path << "\n";
+			close();
+			return false;
+		}
+	
+	return true;
+}
+
+const IndexCache::Entry *IndexCache::find(const SourceFile &file) const
+{
+	if (m_index.empty())
+		for (const Entry &entry : m_entries)
+			m_index.emplace(std::string(m_names + entry.name, entry.name_size), &entry);
+	
+	auto it = m_index.find(file.m_path.string());
+	return it == m_index.end() || !matches(*it->second, file) ? nullptr : it->second;
+}
+
+bool IndexCache::matches(const Entry &entry, const SourceFile &file) const
+{
+	const std::string &name = file.m_path.string();
+	return
+		entry.mtime == file.m_mtime && entry.size == file.m_bytes &&
+		entry.name_size == name.size() &&
+		std::memcmp(m_names + entry.name, name.data(), name.size()) == 0;
+}
+
+template<typename T>
+static void put(std::ostream &out, const T *data, std::size_t n)
+{
+	out.write(reinterpret_cast<const char *>(data), n * sizeof(T));
+}
+
+bool IndexCache::write(
+	const fs::path &path, int runs, Normalize normalize, bool compare, bool exact,
+	const std::vector<SourceFile *> &files, const Corpus &corpus,
+	alg::array_view<Point> vertices, alg::array_view<Line> vlines,
+	const CloneClasses &classes
+) {
+	Header header;
+	std::memcpy(header.magic, s_magic, sizeof(s_magic));
+	header.version  = s_version;
+	header.runs     = runs;
+	header.normalize = int(normalize);
+	header.compare  = compare;
+	header.exact    = exact;
+	header.files    = files.size();
+	header.hashes   = 0;
+	header.vertices = vertices.size();
+	header.vlines   = vlines.size();
+	header.classes  = classes.classes().size();
+	header.class_members = classes.members().size();
+	header.names    = 0;
+	
+	std::vector<Entry> entries;
+	entries.reserve(files.size());
+	for (const SourceFile *file : files) {
+		Entry entry;
+		entry.mtime     = file->m_mtime;
+		entry.size      = file->m_bytes;
+		entry.name      = header.names;
+		entry.hash      = header.hashes;
+		entry.name_size = file->m_path.string().size();
+		entry.position  = file->m_position;
+		entry.lines     = file->line_count();
+		entry.tree      = file->m_tree;
+		entries.push_back(entry);
+		
+		header.names  += entry.name_size;
+		header.hashes += entry.lines;
+	}
+	
+	// Write aside and rename, so a concurrent reader never maps half a file.
+	fs::path tmp(path.string() + ".tmp");
+	std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+	put(out, &header, 1);
+	put(out, entries.data(), entries.size());
+	for (const SourceFile *file : files)
+		put(out, corpus.hashes(*file).data(), file->line_count());
+	put(out, vertices.data(), vertices.size());
+	put(out, vlines.data(), vlines.size());
+	put(out, classes.classes().data(), classes.classes().size());
+	put(out, classes.members().data(), classes.members().size());
+	for (const SourceFile *file : files)
+		put(out, file->m_path.string().data(), file->m_path.string().size());
+	out.close();
+	
+	boost::system::error_code error;
+	if (out) fs::rename(tmp, path, error);
+	if (!out || error) {
+		std::cerr << "Could not write cache " << path << "\n";
+		fs::remove(tmp, error);
+		return false;
+	}
+	
+	return true;
+}
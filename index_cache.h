@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef INDEX_CACHE_H
+#define INDEX_CACHE_H
+
+#include "algorithm_ext.h"
+#include "clone_classes.h"
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+class Corpus;
+struct SourceFile;
+enum class Normalize;
+
+// Memory mapped cache of the file table, the line hashes and the final
+// clone points and lines of a previous run.
+class IndexCache
+{
+public:
+	typedef std::pair<std::int32_t, std::int32_t> Point;
+	typedef std::pair<Point, Point> Line;
+	
+	struct Entry {
+		std::int64_t  mtime;
+		std::uint64_t size;
+		std::uint64_t name;      // Offset in the name table
+		std::uint64_t hash;      // Index of the first line hash
+		std::uint32_t name_size;
+		std::int32_t  position;
+		std::uint32_t lines;
+		std::int32_t  tree;
+	};
+	
+	IndexCache() {}
+	~IndexCache();
+	
+	bool open(const boost::filesystem::path &path, int runs, Normalize normalize, bool compare, bool exact);
+	
+	std::size_t size() const { return m_entries.size(); }
+	const Entry &entry(std::size_t i) const { return m_entries[i]; }
+	const Entry *find(const SourceFile &file) const;
+	bool matches(const Entry &entry, const SourceFile &file) const;
+	
+	alg::array_view<std::uint64_t> hashes(const Entry &entry) const
+	{ return alg::array_view<std::uint64_t>(m_hashes.data() + entry.hash, entry.lines); }
+	alg::array_view<Point> vertices() const { return m_vertices; }
+	alg::array_view<Line> vlines() const { return m_vlines; }
+	alg::array_view<CloneClasses::Class> classes() const { return m_classes; }
+	alg::array_view<std::int32_t> class_members() const { return m_class_members; }
+	
+	static bool write(
+		const boost::filesystem::path &path, int runs, Normalize normalize, bool compare, bool exact,
+		const std::vector<SourceFile *> &files, const Corpus &corpus,
+		alg::array_view<Point> vertices, alg::array_view<Line> vlines,
+		const CloneClasses &classes
+	);
+	
+private:
+	struct Header {
+		char magic[8];
+		std::uint32_t version;
+		std::int32_t runs;
+		std::int32_t normalize;
+		std::int32_t compare;
+		std::int32_t exact; // Without near-miss clones
+		std::uint64_t files, hashes, vertices, vlines, classes, class_members, names;
+	};
+	
+	static const char s_magic[8];
+	static const std::uint32_t s_version = 7;
+	
+	void close();
+	
+	void *m_data = nullptr;
+	std::size_t m_size = 0;
+	
+	alg::array_view<Entry> m_entries;
+	alg::array_view<std::uint64_t> m_hashes;
+	alg::array_view<Point> m_vertices;
+	alg::array_view<Line> m_vlines;
+	alg::array_view<CloneClasses::Class> m_classes;
+	alg::array_view<std::int32_t> m_class_members;
+	const char *m_names = nullptr;
+	
+	mutable std::unordered_map<std::string, const Entry *> m_index;
+};
+
+#endif // INDEX_CACHE_H
@@ -26,7 +26,33 @@
 
 #include "environment_2d.h"
 #include "clone_grid.h"
+#include "hash_detector.h"
+#include "near_detector.h"
+#include "profiler.h"
+#include "sort_detector.h"
+#include "suffix_detector.h"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <vector>
+
+static void usage(const char *name)
+{
+	std::cout << "Usage: " << name << " [--engine=hash|sort|suffix|near] [--runs=<lines>] [--cache=<file>] [--watch] [--compare] [--budget=<MiB>]"
+		" [--normalize=whitespace|tokens]"
+		" [--ignore=<pattern>] [--headless] [--report=<file.json|file.csv>]"
+		" [--image=<file.png>] [--image-size=<pixels>]"
+		" [--profile=<file.json>] [--trace=<file.json>] <path> [<path2> ...]\n";
+}
+
+// A whole number from 1 to most, or 0 when the value is anything else.
+static std::uint64_t count(const std::string &value, std::uint64_t most)
+{
+	if (value.empty() || value.size() > 18 || value.find_first_not_of("0123456789") != std::string::npos)
+		return 0;
+	std::uint64_t n = std::stoull(value);
+	return n <= most ? n : 0;
+}
 
 int main(int argc, char **argv)
 {
@@ -34,19 +60,87 @@ int main(int argc, char **argv)
 	"Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>\n"
 	"All rights reserved.\n\n";
 
-	Environment2D::init(argc, argv);
+	// Images are made without a window.
+	bool headless = std::find_if(argv + 1, argv + argc, [] (const char *arg) {
+		return arg == std::string("--headless") || std::string(arg).compare(0, 8, "--image=") == 0;
+	}) != argv + argc;
+	if (!headless)
+		Environment2D::init(argc, argv);
 
 	if (argc <= 1) {
-		std::cout << "Usage: " << argv[0] << " <path> [<path2> ...]\n";
+		usage(argv[0]);
 		return 0;
 	}
 
 	CloneGrid grid;
-	for (int i = 1; i < argc; i++)
-		grid.read_source(argv[i]);
-	grid.finalize();
-	grid.print_statistics();
+	std::vector<std::string> paths;
+	std::string image;
+	int image_size = 4096;
+	auto invalid = [&] (const std::string &arg) {
+		std::cerr << "Invalid value: " << arg << "\n";
+		usage(argv[0]);
+		return 1;
+	};
+	for (int i = 1; i < argc; i++) {
+		std::string arg(argv[i]);
+		std::uint64_t n = 0;
+		if (arg == "--engine=hash")
+			grid.set_detector(new HashDetector);
+		else if (arg == "--engine=sort")
+			grid.set_detector(new SortDetector);
+		else if (arg == "--engine=suffix")
+			grid.set_detector(new SuffixDetector);
+		else if (arg == "--engine=near")
+			grid.set_detector(new NearDetector);
+		else if (arg.compare(0, 7, "--runs=") == 0) {
+			if (!(n = count(arg.substr(7), 1 << 20))) return invalid(arg);
+			grid.set_runs(n);
+		}
+		else if (arg.compare(0, 8, "--cache=") == 0)
+			grid.set_cache(arg.substr(8));
+		else if (arg == "--normalize=whitespace")
+			grid.set_normalize(Normalize::whitespace);
+		else if (arg == "--normalize=tokens")
+			grid.set_normalize(Normalize::tokens);
+		else if (arg == "--watch")
+			grid.set_watch(true);
+		else if (arg == "--compare")
+			grid.set_compare(true);
+		else if (arg.compare(0, 9, "--budget=") == 0) {
+			if (!(n = count(arg.substr(9), SIZE_MAX >> 20))) return invalid(arg);
+			grid.set_budget(n << 20);
+		}
+		else if (arg.compare(0, 9, "--ignore=") == 0)
+			grid.add_ignore(arg.substr(9));
+		else if (arg.compare(0, 9, "--report=") == 0)
+			grid.set_report(arg.substr(9));
+		else if (arg.compare(0, 8, "--image=") == 0)
+			image = arg.substr(8);
+		else if (arg.compare(0, 13, "--image-size=") == 0) {
+			if (!(n = count(arg.substr(13), 1 << 16))) return invalid(arg);
+			image_size = n;
+		}
+		else if (arg.compare(0, 10, "--profile=") == 0)
+			Profiler::set_report(arg.substr(10));
+		else if (arg.compare(0, 8, "--trace=") == 0)
+			Profiler::set_trace(arg.substr(8));
+		else if (arg != "--headless")
+			paths.push_back(arg);
+	}
+
+	// Paths are read after all options, --ignore=<pattern> applies to each.
+	for (const std::string &path : paths)
+		grid.read_source(path);
+	if (headless) {
+		grid.finalize();
+		if (!image.empty())
+			grid.write_image(image, image_size);
+		grid.print_statistics();
+		return 0;
+	}
 
+	// The window opens right away and shows the analysis as it goes.
+	grid.finalize_async();
 	Environment2D::set_drawable(&grid);
 	Environment2D::start();
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "near_detector.h"
+#include "algorithm_ext.h"
+#include "corpus.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <deque>
+#include <parallel/algorithm>
+
+namespace {
+
+typedef std::pair<std::uint32_t, std::uint32_t> Pair; // First lines a < b
+
+// Lines a + i and b + i are alike for all i < length.
+struct Segment {
+	std::uint32_t a, b, length;
+	
+	bool operator<(const Segment &s) const
+	{ return b - a < s.b - s.a || (b - a == s.b - s.a && a < s.a); }
+};
+
+struct Entry {
+	std::uint64_t key;
+	std::uint32_t line;
+	
+	bool operator<(const Entry &e) const
+	{ return key < e.key || (key == e.key && line < e.line); }
+};
+
+const int s_bands = 8, s_rows = 4; // Of a signature, candidates share a band
+const int s_lookahead = 3;         // Lines added or replaced in one go
+const double s_similarity = .7;    // Of the lines in every block of a clone
+
+// The minima of a row slide along the lines in a queue of rising hashes.
+struct Queue {
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> hashes;
+	std::size_t head;
+};
+
+// Line ids are hashes already, a row only permutes them. The seeds and odd
+// factors come from splitmix64.
+std::uint64_t seed(int i)
+{
+	std::uint64_t h = (i + 1) * 0x9e3779b97f4a7c15;
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+	return h ^ (h >> 31);
+}
+
+// One band of the signature of every block of lines in [first, last), but
+// only where it differs from the block before; clones of each other then
+// keep the same first lines.
+void band(alg::array_view<std::uint64_t> ids, std::uint32_t first, std::uint32_t last, int block, int b,
+	Queue (&rows)[s_rows], std::vector<Entry> &out)
+{
+	std::uint64_t seeds[s_rows], factors[s_rows], previous = 0;
+	for (int r = 0; r < s_rows; ++r) {
+		seeds[r] = seed(2 * (b * s_rows + r));
+		factors[r] = seed(2 * (b * s_rows + r) + 1) | 1;
+		rows[r].hashes.clear();
+		rows[r].head = 0;
+	}
+	for (std::uint32_t l = first; l < last; ++l) {
+		std::uint64_t key = b;
+		for (int r = 0; r < s_rows; ++r) {
+			Queue &q = rows[r];
+			std::uint64_t h = (ids[l] ^ seeds[r]) * factors[r];
+			while (q.hashes.size() > q.head && q.hashes.back().first >= h) q.hashes.pop_back();
+			q.hashes.emplace_back(h, l);
+			if (q.hashes[q.head].second + block <= l) q.head++;
+			key = (key + q.hashes[q.head].first) * 0x100000001b3;
+		}
+		if (l + 1 < first + block) continue;
+		if (l + 1 == first + block || key != previous)
+			out.push_back(Entry{key, l + 1 - block});
+		previous = key;
+	}
+}
+
+// Candidates only say that the blocks at a and b are alike, the clone may
+// be a few lines off: it starts at the first two equal lines of both.
+bool align(alg::array_view<std::uint64_t> ids, Pair &p, std::uint32_t a_end, std::uint32_t b_end, int block)
+{
+	for (int n = 0; n < 2 * block - 1; ++n)
+	for (int i = std::max(0, n - block + 1); i <= std::min(n, block - 1); ++i) {
+		std::uint32_t a = p.first + i, b = p.second + n - i;
+		if (a + 1 < a_end && b + 1 < b_end && ids[a] == ids[b] && ids[a + 1] == ids[b + 1]) {
+			p = Pair(a, b);
+			return a < b;
+		}
+	}
+	return false;
+}
+
+// Follows the clone from the equal lines a and b on, until more than a few
+// lines of the last block differ. Replaced lines keep to the diagonal, added
+// lines move the rest onto another. The parts go to out, when they have at
+// least block lines together.
+std::uint32_t follow(alg::array_view<std::uint64_t> ids, Pair p, std::uint32_t a_end, std::uint32_t b_end, int block, std::vector<Segment> &out)
+{
+	const std::size_t allowed = block - int(std::ceil(s_similarity * block));
+	auto equal = [&] (std::uint32_t i, std::uint32_t j) {
+		return i + 1 < a_end && j + 1 < b_end && ids[i] == ids[j] && ids[i + 1] == ids[j + 1];
+	};
+	
+	std::size_t first = out.size();
+	std::deque<std::uint32_t> misses; // Steps at which lines differed
+	std::uint32_t i = p.first, j = p.second, step = 0, lines = 0, end = i;
+	Segment part = {i, j, 0};
+	auto close = [&] {
+		if (!part.length) return;
+		if (out.size() == first) end = part.a + part.length;
+		out.push_back(part);
+		lines += part.length;
+	};
+	while (i < a_end && j < b_end) {
+		if (ids[i] == ids[j]) {
+			part.length = ++i - part.a;
+			++j; ++step;
+			continue;
+		}
+		
+		// Skip the fewest lines to get back in step, replaced ones first.
+		int di = 1, dj = 1;
+		for (int n = 1; n <= 2 * s_lookahead; ++n) {
+			if (n % 2 == 0 && equal(i + n / 2, j + n / 2)) { di = dj = n / 2; break; }
+			int x = 0;
+			for (; x <= n && (x == n - x || x > s_lookahead || n - x > s_lookahead || !equal(i + x, j + n - x)); ++x);
+			if (x <= n) { di = x; dj = n - x; break; }
+		}
+		step += std::max(di, dj);
+		for (int k = std::max(di, dj); k > 0; --k)
+			misses.push_back(step);
+		while (!misses.empty() && misses.front() + block <= step)
+			misses.pop_front();
+		if (misses.size() > allowed) break;
+		
+		if (di != dj) {
+			close();
+			part = Segment{i + di, j + dj, 0};
+		}
+		i += di; j += dj;
+	}
+	close();
+	
+	if (lines < std::uint32_t(block)) {
+		out.resize(first);
+		return p.first + 1;
+	}
+	return end;
+}
+
+}
+
+bool NearDetector::detect_runs(Corpus &corpus, Lines &lines, int runs, int pairs, const Group &group, const Run &run)
+{
+	// Windows of groups too big to pair up know their group, so that the
+	// copies of a clone class don't come back as near-miss pairs.
+	std::vector<std::int32_t> classes(corpus.size(), -1);
+	std::int32_t large = 0;
+	std::vector<Segment> segments;
+	SuffixDetector::detect_runs(corpus, lines, runs, pairs, [&] (Lines::iterator first, Lines::iterator last) {
+		if (last + 1 - first >= pairs) {
+			for (Lines::iterator it = first; it != last + 1; ++it)
+				classes[*it] = large;
+			large++;
+		}
+		group(first, last);
+	}, [&] (std::uint32_t a, std::uint32_t b, std::uint32_t length) {
+		segments.push_back(Segment{a, b, length});
+	});
+	
+	alg::array_view<std::uint64_t> ids = corpus.line_hashes();
+	alg::array_view<std::uint32_t> borders = corpus.borders();
+	const int block = 4 * runs;
+	const std::size_t files = borders.empty() ? 0 : borders.size() - 1;
+	auto file_end = [&] (std::uint32_t line) {
+		return *std::upper_bound(borders.begin(), borders.end(), line);
+	};
+	
+	// Blocks that share a band are candidates, unless they overlap or share
+	// it with too many others: those are clone classes already.
+	std::vector<Pair> candidates;
+	for (int b = 0; b < s_bands; ++b) {
+		Profiler::Phase phase("minhash band", corpus.size());
+		std::vector<Entry> entries;
+		#pragma omp parallel
+		{
+			std::vector<Entry> part;
+			Queue rows[s_rows];
+			#pragma omp for schedule(dynamic, 64) nowait
+			for (std::size_t f = 0; f < files; ++f)
+				band(ids, borders[f], borders[f + 1], block, b, rows, part);
+			#pragma omp critical
+			entries.insert(end(entries), begin(part), end(part));
+		}
+		__gnu_parallel::sort(begin(entries), end(entries));
+		
+		typedef std::vector<Entry>::iterator iterator;
+		alg::parallel_process_adjacent<std::vector<Pair>>(begin(entries), end(entries),
+			[] (const Entry &x, const Entry &y) { return x.key == y.key; },
+			[] (std::vector<Pair> &, iterator, iterator) {},
+			[&] (std::vector<Pair> &found, iterator first, iterator last) {
+				if (last + 1 - first >= pairs) return;
+				for (iterator x = first; x != last; ++x)
+				for (iterator y = x + 1; y != last + 1; ++y)
+					if (x->line + block <= y->line) found.emplace_back(x->line, y->line);
+			}, [&] (const std::vector<Pair> &found) {
+				candidates.insert(end(candidates), begin(found), end(found));
+			}
+		);
+	}
+	
+	Profiler::Phase phase("near clones", candidates.size());
+	__gnu_parallel::sort(begin(candidates), end(candidates));
+	candidates.erase(std::unique(begin(candidates), end(candidates)), end(candidates));
+	
+	#pragma omp parallel for schedule(dynamic, 1024)
+	for (std::size_t k = 0; k < candidates.size(); ++k) {
+		Pair &p = candidates[k];
+		if (!align(ids, p, file_end(p.first), file_end(p.second), block) || (classes[p.first] >= 0 && classes[p.first] == classes[p.second]))
+			p = Pair(0, 0);
+	}
+	candidates.erase(std::remove(begin(candidates), end(candidates), Pair(0, 0)), end(candidates));
+	
+	// Candidates on a diagonal in line order; those inside a clone that was
+	// followed already are left out.
+	auto diagonal = [] (const Pair &p) { return p.second - p.first; };
+	__gnu_parallel::sort(begin(candidates), end(candidates), [&] (const Pair &x, const Pair &y) {
+		return diagonal(x) < diagonal(y) || (diagonal(x) == diagonal(y) && x.first < y.first);
+	});
+	typedef std::vector<Pair>::iterator iterator;
+	auto clones = [&] (std::vector<Segment> &found, iterator first, iterator last) {
+		std::uint32_t covered = 0;
+		for (iterator c = first; c != last + 1; ++c) {
+			if (c != first && diagonal(*c) != diagonal(c[-1])) covered = 0;
+			if (c->first < covered) continue;
+			covered = follow(ids, *c, file_end(c->first), file_end(c->second), block, found);
+		}
+	};
+	std::size_t exact = segments.size();
+	alg::parallel_process_adjacent<std::vector<Segment>>(begin(candidates), end(candidates),
+		[&] (const Pair &x, const Pair &y) { return diagonal(x) == diagonal(y); }, clones, clones,
+		[&] (const std::vector<Segment> &found) {
+			for (const Segment &s : found)
+				if (s.length >= std::uint32_t(runs) && s.a < s.b)
+					segments.push_back(Segment{s.a, s.b, s.length + 1 - runs});
+		}
+	);
+	phase.items(segments.size() - exact);
+	phase.end();
+	
+	// Runs of windows along each diagonal, where the clones overlap or touch.
+	Profiler::Phase merge("merge runs", segments.size());
+	__gnu_parallel::sort(begin(segments), end(segments));
+	for (std::size_t i = 0, j; i < segments.size(); i = j) {
+		Segment s = segments[i];
+		for (j = i + 1; j < segments.size() && segments[j].b - segments[j].a == s.b - s.a && segments[j].a <= s.a + s.length; ++j)
+			s.length = std::max(s.length, segments[j].a + segments[j].length - s.a);
+		run(s.a, s.b, s.length);
+	}
+	return true;
+}
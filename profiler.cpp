@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "profiler.h"
+
+#include <boost/format.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+struct Event {
+	const char *name;
+	std::int64_t start, wall, cpu; // Nanoseconds
+	std::int64_t peak, rss, grown; // Most resident, at the end and growth, bytes
+	std::size_t items;
+	int depth, thread;
+};
+
+// A phase and all of its repeats, e.g. every frame.
+struct Total {
+	const char *name;
+	std::int64_t start;            // Of the first repeat
+	std::size_t count, items;
+	std::int64_t wall, cpu;
+	std::int64_t peak;             // Most resident in any repeat
+	std::int64_t rss, grown;       // Most resident at an end, growth of all repeats
+};
+
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static bool s_enabled = false;
+static bool s_registered = false;
+static fs::path s_report_path, s_trace_path;
+static std::mutex s_mutex;
+static std::vector<Total> s_totals;
+static std::vector<Event> s_events;            // Only kept for a trace
+static std::vector<std::int64_t *> s_peaks;    // Of the open phases
+static std::int64_t s_peak = 0;                // Of the run, up to the last reset
+static int s_threads = 0;
+static thread_local int s_depth = 0;
+static thread_local int s_thread = -1;
+static const Clock::time_point s_start = Clock::now();
+
+static std::int64_t wall_time()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s_start).count();
+}
+
+// Of all threads together, so parallel phases use more CPU than wall time,
+// and phases on different threads count each other's time.
+static std::int64_t cpu_time()
+{
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return std::int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Of the whole run, reported once at the end. Since the last reset of
+// VmHWM, the rest was kept on the way.
+static std::int64_t peak_rss()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return std::max(s_peak, std::int64_t(usage.ru_maxrss) * 1024);
+}
+
+// Resident now, so a phase can be told by what it holds or frees.
+static std::int64_t current_rss()
+{
+	long pages = 0, resident = 0;
+	std::FILE *file = std::fopen("/proc/self/statm", "r");
+	if (file) {
+		if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2) resident = 0;
+		std::fclose(file);
+	}
+	return std::int64_t(resident) * sysconf(_SC_PAGESIZE);
+}
+
+// VmHWM, the most resident since the last reset_peak().
+static std::int64_t resident_peak()
+{
+	long peak = 0;
+	char line[128];
+	std::FILE *file = std::fopen("/proc/self/status", "r");
+	if (file) {
+		while (std::fgets(line, sizeof(line), file))
+			if (std::sscanf(line, "VmHWM: %ld", &peak) == 1) break;
+		std::fclose(file);
+	}
+	return std::int64_t(peak) * 1024;
+}
+
+// Lowers VmHWM to what is resident now, from Linux 4.0. Without it a phase
+// gets the peak of the run so far.
+static void reset_peak()
+{
+	std::FILE *file = std::fopen("/proc/self/clear_refs", "w");
+	if (file) {
+		std::fputs("5", file);
+		std::fclose(file);
+	}
+}
+
+// Phases by name, in the order they first started.
+static std::vector<Total> totals()
+{
+	std::vector<Total> totals;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		totals = s_totals;
+	}
+	std::stable_sort(begin(totals), end(totals),
+		[] (const Total &a, const Total &b) { return a.start < b.start; });
+	return totals;
+}
+
+Profiler::Phase::Phase(const char *name, std::size_t items) :
+	m_name(name),
+	m_items(items),
+	m_open(s_enabled)
+{
+	if (!m_open) return;
+	m_wall = wall_time();
+	m_cpu = cpu_time();
+	++s_depth;
+	
+	// Open phases keep the peak so far, then it starts over for this one.
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::int64_t peak = resident_peak();
+	for (std::int64_t *p : s_peaks)
+		*p = std::max(*p, peak);
+	s_peak = std::max(s_peak, peak);
+	reset_peak();
+	m_rss = m_peak = current_rss();
+	s_peaks.push_back(&m_peak);
+}
+
+void Profiler::Phase::end()
+{
+	if (!m_open) return;
+	m_open = false;
+	std::int64_t wall = wall_time(), cpu = cpu_time(), rss = current_rss();
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_peaks.erase(std::find(s_peaks.begin(), s_peaks.end(), &m_peak));
+	m_peak = std::max({m_peak, rss, resident_peak()});
+	Event event{m_name, m_wall, wall - m_wall, cpu - m_cpu, m_peak, rss, rss - m_rss, m_items, --s_depth, 0};
+	
+	// Repeats add up right away, only a trace keeps every event.
+	auto it = std::find_if(s_totals.begin(), s_totals.end(),
+		[&] (const Total &t) { return std::strcmp(t.name, m_name) == 0; });
+	if (it == s_totals.end())
+		it = s_totals.insert(s_totals.end(), Total{m_name, m_wall, 0, 0, 0, 0, 0, 0, 0});
+	it->start  = std::min(it->start, event.start);
+	it->count += 1;
+	it->items += event.items;
+	it->wall  += event.wall;
+	it->cpu   += event.cpu;
+	it->peak   = std::max(it->peak, event.peak);
+	it->rss    = std::max(it->rss, event.rss);
+	it->grown += event.grown;
+	
+	if (s_trace_path.empty()) return;
+	if (s_thread < 0) s_thread = s_threads++;
+	event.thread = s_thread;
+	s_events.push_back(event);
+}
+
+static void enable()
+{
+	s_enabled = true;
+	if (!s_registered) std::atexit(Profiler::write);
+	s_registered = true;
+}
+
+void Profiler::set_report(const fs::path &path)
+{
+	s_report_path = path;
+	enable();
+}
+
+void Profiler::set_trace(const fs::path &path)
+{
+	s_trace_path = path;
+	enable();
+}
+
+bool Profiler::enabled()
+{
+	return s_enabled;
+}
+
+void Profiler::print(std::ostream &out)
+{
+	if (!s_enabled) return;
+	
+	out << "\nPhases:              wall         cpu        peak         RSS      RSS +/-        items\n";
+	for (const Total &t : totals())
+		out << boost::format("%-14s %9.3f s %9.3f s %7.1f MiB %7.1f MiB %8.1f MiB %12d%s\n")
+			% t.name % (t.wall * 1e-9) % (t.cpu * 1e-9) % (t.peak / 1024. / 1024.) % (t.rss / 1024. / 1024.)
+			% (t.grown / 1024. / 1024.) % t.items
+			% (t.count > 1 ? (boost::format(" (%dx)") % t.count).str() : "");
+}
+
+void Profiler::write()
+{
+	if (!s_report_path.empty()) {
+		std::ofstream out(s_report_path.string());
+		out << "{\n\"phases\": [";
+		bool first = true;
+		for (const Total &t : totals()) {
+			out << (first ? "\n" : ",\n") << boost::format(
+				"{\"name\": \"%s\", \"count\": %d, \"wall\": %.6f, \"cpu\": %.6f, \"peak_rss\": %d, \"rss\": %d, \"rss_delta\": %d, \"items\": %d}")
+				% t.name % t.count % (t.wall * 1e-9) % (t.cpu * 1e-9) % t.peak % t.rss % t.grown % t.items;
+			first = false;
+		}
+		out << "\n],\n\"peak_rss\": " << peak_rss() << "\n}\n";
+		if (!out) std::cerr << "Could not write profile " << s_report_path << "\n";
+	}
+	
+	// Complete events nest by time, RSS is also a counter track.
+	if (!s_trace_path.empty()) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		std::ofstream out(s_trace_path.string());
+		out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+		bool first = true;
+		for (const Event &e : s_events) {
+			out << (first ? "\n" : ",\n") << boost::format(
+				"{\"name\": \"%s\", \"cat\": \"clonegrid\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+				"\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"cpu_ms\": %.3f, \"peak_mib\": %.1f, \"items\": %d, \"depth\": %d}},\n"
+				"{\"name\": \"RSS\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, \"args\": {\"MiB\": %.1f}}")
+				% e.name % (e.thread + 1) % (e.start * 1e-3) % (e.wall * 1e-3) % (e.cpu * 1e-6) % (e.peak / 1024. / 1024.) % e.items % e.depth
+				% ((e.start + e.wall) * 1e-3) % (e.rss / 1024. / 1024.);
+			first = false;
+		}
+		out << "\n]}\n";
+		if (!out) std::cerr << "Could not write trace " << s_trace_path << "\n";
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <iosfwd>
+
+// Records the phases of a run: wall and CPU time, the peak RSS, the RSS at
+// the end and how it changed, and the number of items handled. Off until a report or
+// trace is asked for, then both are written when the program exits.
+class Profiler
+{
+public:
+	// Times a phase from construction until end() or destruction.
+	// Phases nest per thread.
+	class Phase
+	{
+	public:
+		explicit Phase(const char *name, std::size_t items = 0);
+		~Phase() { end(); }
+		
+		void items(std::size_t items) { m_items = items; }
+		void end();
+		
+	private:
+		const char *m_name;
+		std::size_t m_items;
+		std::int64_t m_wall, m_cpu; // Nanoseconds at the start
+		std::int64_t m_rss;         // Bytes resident at the start
+		std::int64_t m_peak;        // Most bytes resident since the start
+		bool m_open;
+	};
+	
+	// A summary of all phases as JSON.
+	static void set_report(const boost::filesystem::path &path);
+	
+	// Every phase as an event in the Chrome trace format.
+	static void set_trace(const boost::filesystem::path &path);
+	
+	static bool enabled();
+	static void print(std::ostream &out);
+	static void write();
+};
+
+#endif // PROFILER_H
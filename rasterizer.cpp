@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rasterizer.h"
+
+#include <omp.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+
+// Clone density of one band of rows, in lines per pixel. Lines map to
+// pixels as line * width / size, so they stay exact on any corpus.
+class Band
+{
+public:
+	Band(std::int64_t size, std::int64_t width, int row, int rows)
+		: m_size(size), m_width(width), m_row(row), m_rows(rows),
+		  m_density(width * rows) {}
+	
+	int pixel(std::int64_t line) const { return line * m_width / m_size; }
+	std::int64_t line(std::int64_t pixel) const { return (pixel * m_size + m_width - 1) / m_width; }
+	float density(int x, int y) const { return m_density[(y - m_row) * m_width + x]; }
+	
+	// Lines of [first, last) in pixel p, fractions of them when magnified.
+	double lines(std::int64_t first, std::int64_t last, int p) const
+	{
+		double low = double(p) * m_size / m_width, high = double(p + 1) * m_size / m_width;
+		return std::max(0., std::min<double>(last, high) - std::max<double>(first, low));
+	}
+	
+	void add(int x, int y, float value)
+	{
+		if (y >= m_row) m_density[(y - m_row) * m_width + x] += value;
+	}
+	
+	// A diagonal run of n lines from (x, y), rows outside the band are skipped.
+	void run(std::int64_t x, std::int64_t y, std::int64_t n, float weight)
+	{
+		std::int64_t skip = std::max<std::int64_t>(0, line(m_row) - y);
+		x += skip; y += skip; n -= skip;
+		
+		if (m_size < m_width) {
+			// Magnified, every pixel on the way gets one line's worth.
+			int px = pixel(x), py = pixel(y), m = n > 0 ? pixel(x + n - 1) - px : -1;
+			for (int i = 0; i <= m && py + i < m_row + m_rows; ++i)
+				add(px + i, py + i, weight * m_size / m_width);
+			return;
+		}
+		
+		// Several lines per pixel, walked pixel by pixel.
+		while (n > 0) {
+			int px = pixel(x), py = pixel(y);
+			if (py >= m_row + m_rows) break;
+			std::int64_t m = std::min({n, line(px + 1) - x, line(py + 1) - y});
+			add(px, py, m * weight);
+			x += m; y += m; n -= m;
+		}
+	}
+	
+private:
+	std::int64_t m_size, m_width;
+	int m_row, m_rows;
+	std::vector<float> m_density;
+};
+
+// Big endian, as in PNG.
+void store(unsigned char *out, std::uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		out[i] = value >> (24 - 8 * i);
+}
+
+void chunk(std::FILE *file, const char *type, const unsigned char *data, std::size_t size)
+{
+	unsigned char length[4], crc[4];
+	store(length, size);
+	uLong sum = crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef *>(type), 4);
+	store(crc, size ? crc32(sum, data, size) : sum);
+	
+	std::fwrite(length, 1, 4, file);
+	std::fwrite(type, 1, 4, file);
+	std::fwrite(data, 1, size, file);
+	std::fwrite(crc, 1, 4, file);
+}
+
+// Raw deflate, ending on a full flush so the next band can follow, or on
+// the final block. Mostly empty, so the fastest level does well.
+void compress(const unsigned char *data, std::size_t size, bool last, std::vector<unsigned char> &out)
+{
+	z_stream z = z_stream();
+	deflateInit2(&z, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+	out.resize(deflateBound(&z, size) + 16);
+	z.next_in = const_cast<unsigned char *>(data);
+	z.avail_in = size;
+	z.next_out = out.data();
+	z.avail_out = out.size();
+	deflate(&z, last ? Z_FINISH : Z_FULL_FLUSH);
+	out.resize(out.size() - z.avail_out);
+	deflateEnd(&z);
+}
+
+// Indices of the elements in every band, bands of a band range from rows().
+template<typename T, typename Rows>
+void bucket(alg::array_view<T> elements, int bands, Rows rows,
+	std::vector<std::size_t> &offsets, std::vector<std::uint32_t> &indices)
+{
+	offsets.assign(bands + 1, 0);
+	for (const T &e : elements) {
+		std::pair<int, int> r = rows(e);
+		for (int b = r.first; b <= r.second; ++b)
+			offsets[b + 1]++;
+	}
+	std::partial_sum(begin(offsets), end(offsets), begin(offsets));
+	
+	indices.resize(offsets.back());
+	std::vector<std::size_t> next(begin(offsets), end(offsets) - 1);
+	for (std::size_t i = 0; i < elements.size(); ++i) {
+		std::pair<int, int> r = rows(elements[i]);
+		for (int b = r.first; b <= r.second; ++b)
+			indices[next[b]++] = i;
+	}
+}
+
+}
+
+bool Rasterizer::write(const boost::filesystem::path &path, int width) const
+{
+	if (m_size <= 0 || width <= 0) return false;
+	
+	const int bands = (width + s_rows - 1) / s_rows;
+	Band map(m_size, width, 0, 0);
+	auto band_of = [&] (std::int64_t line) { return map.pixel(line) / s_rows; };
+	
+	// Points and lines are one half of the grid, mirrored they are the other.
+	const int halves = m_split ? 1 : 2;
+	std::vector<std::size_t> point_offsets[2], line_offsets[2];
+	std::vector<std::uint32_t> point_indices[2], line_indices[2];
+	for (int m = 0; m < halves; ++m) {
+		bucket(m_points, bands, [&] (const Point &p) {
+			int b = band_of(m ? p.first : p.second);
+			return std::make_pair(b, b);
+		}, point_offsets[m], point_indices[m]);
+		bucket(m_lines, bands, [&] (const Line &l) {
+			return m ? std::make_pair(band_of(l.first.first), band_of(l.second.first))
+			         : std::make_pair(band_of(l.first.second), band_of(l.second.second));
+		}, line_offsets[m], line_indices[m]);
+	}
+	
+	// Members of every class binned per pixel, pairs of bins are runs of the
+	// first members, weighted by the number of pairs. Members are sorted.
+	// Bins don't cross the split, then bins after it pair with those before.
+	// Classes over too many pixels to pair their bins keep the lines of their
+	// members per column instead, rows are summed per band the same way.
+	std::vector<std::vector<Bin>> bins;
+	std::vector<std::vector<std::pair<int, float>>> columns(m_classes.classes().size());
+	std::vector<double> column(width);
+	for (const CloneClasses::Class &c : m_classes.classes()) {
+		bins.emplace_back();
+		for (int p : m_classes.members(c))
+			if (!bins.back().empty() && map.pixel(bins.back().back().first) == map.pixel(p) &&
+				(bins.back().back().first < m_split) == (p < m_split))
+				bins.back().back().count++;
+			else
+				bins.back().push_back(Bin{p, 1});
+		if (bins.back().size() <= s_class_bins) continue;
+		
+		bins.back().clear();
+		for (int p : m_classes.members(c)) {
+			if (m_split && p >= m_split) break;
+			for (int x = map.pixel(p); x < width && double(x) * m_size / width < p + c.length; ++x)
+				column[x] += map.lines(p, p + c.length, x);
+		}
+		for (int x = 0; x < width; ++x)
+			if (column[x] > 0) {
+				columns[bins.size() - 1].emplace_back(x, column[x]);
+				column[x] = 0;
+			}
+	}
+	
+	// File borders per pixel, the same for rows and columns, and their red
+	// by the number of borders in a pixel.
+	const float scale = float(m_size) / width; // Lines per pixel
+	std::vector<int> borders(width);
+	for (int p : m_borders)
+		if (p > 0 && p < m_size) borders[map.pixel(p)]++;
+	std::vector<unsigned char> red(2 * *std::max_element(begin(borders), end(borders)) + 1);
+	for (std::size_t n = 1; n < red.size(); ++n)
+		red[n] = 255 * .6f * std::min(1.f, std::sqrt(n / scale)) + .5f;
+	
+	auto render = [&] (int b, unsigned char *rgb) {
+		int row = b * s_rows, rows = std::min(s_rows, width - row);
+		Band band(m_size, width, row, rows);
+		
+		for (int m = 0; m < halves; ++m) {
+			for (std::size_t i = point_offsets[m][b]; i < point_offsets[m][b + 1]; ++i) {
+				const Point &p = m_points[point_indices[m][i]];
+				band.run(m ? p.second : p.first, m ? p.first : p.second, 1, 1);
+			}
+			for (std::size_t i = line_offsets[m][b]; i < line_offsets[m][b + 1]; ++i) {
+				const Line &l = m_lines[line_indices[m][i]];
+				band.run(m ? l.first.second : l.first.first, m ? l.first.first : l.first.second,
+					l.second.second - l.first.second + 1, 1);
+			}
+		}
+		
+		std::int64_t y0 = band.line(row), y1 = band.line(row + rows);
+		std::vector<double> across(rows);
+		for (std::size_t k = 0; k < bins.size(); ++k) {
+			std::int32_t length = m_classes.classes()[k].length;
+			if (!columns[k].empty()) {
+				// Pairs as the outer product of rows and columns: every pair
+				// still adds length lines, spread over its rows and columns.
+				alg::array_view<std::int32_t> members = m_classes.members(m_classes.classes()[k]);
+				auto p = std::lower_bound(members.begin(), members.end(), std::max<std::int64_t>(y0 - length, m_split));
+				for (; p != members.end() && *p < y1; ++p)
+					for (int y = std::max(row, band.pixel(*p)); y < row + rows && double(y) * m_size / width < *p + length; ++y)
+						across[y - row] += band.lines(*p, *p + length, y);
+				for (int y = 0; y < rows; ++y) {
+					if (across[y] > 0)
+						for (const std::pair<int, float> &x : columns[k])
+							band.add(x.first, row + y, across[y] * x.second / length);
+					across[y] = 0;
+				}
+				continue;
+			}
+			
+			auto first = std::lower_bound(begin(bins[k]), end(bins[k]), std::max<std::int64_t>(y0 - length + 1, m_split),
+				[] (const Bin &bin, std::int64_t y) { return bin.first < y; });
+			for (; first != end(bins[k]) && first->first < y1; ++first)
+				for (const Bin &x : bins[k]) {
+					if (m_split && x.first >= m_split) break;
+					band.run(x.first, first->first, length, float(first->count) * x.count);
+				}
+		}
+		
+		// Red borders, the blue diagonal, then clones in white on top.
+		for (int y = row; y < row + rows; ++y) {
+			*rgb++ = 0; // No filter
+			for (int x = 0; x < width; ++x, rgb += 3) {
+				bool diagonal = x == y && !m_split;
+				unsigned char r = diagonal ? 0 : red[borders[x] + borders[y]], blue = diagonal ? 255 : 0;
+				float d = band.density(x, y);
+				if (d == 0) {
+					rgb[0] = r;
+					rgb[1] = 0;
+					rgb[2] = blue;
+					continue;
+				}
+				
+				float a = std::min(1.f, std::sqrt(d / scale));
+				rgb[0] = 255 * a + r * (1 - a) + .5f;
+				rgb[1] = 255 * a + .5f;
+				rgb[2] = 255 * a + blue * (1 - a) + .5f;
+			}
+		}
+	};
+	
+	// Bands are rendered and deflated a few per core at a time, then written
+	// in order. Every band ends on a full flush, so the streams join into one.
+	const int group = 4 * omp_get_max_threads();
+	const std::size_t stride = 1 + std::size_t(width) * 3; // Filter byte, then RGB
+	std::vector<unsigned char> pixels(group * s_rows * stride);
+	std::vector<std::vector<unsigned char>> deflated(group);
+	std::vector<uLong> adlers(group);
+	
+	std::FILE *file = std::fopen(path.c_str(), "wb");
+	if (!file) return false;
+	
+	unsigned char header[13];
+	store(header, width);
+	store(header + 4, width);
+	std::copy_n("\x08\x02\0\0\0", 5, header + 8); // 8 bit RGB
+	std::fwrite("\x89PNG\r\n\x1a\n", 1, 8, file);
+	chunk(file, "IHDR", header, sizeof(header));
+	chunk(file, "IDAT", reinterpret_cast<const unsigned char *>("\x78\x01"), 2);
+	
+	uLong adler = adler32(0, nullptr, 0);
+	for (int b = 0; b < bands; b += group) {
+		int n = std::min(group, bands - b);
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < n; ++i) {
+			unsigned char *first = &pixels[i * s_rows * stride];
+			std::size_t size = std::min(s_rows, width - (b + i) * s_rows) * stride;
+			render(b + i, first);
+			adlers[i] = adler32(adler32(0, nullptr, 0), first, size);
+			compress(first, size, b + i == bands - 1, deflated[i]);
+		}
+		
+		for (int i = 0; i < n; ++i) {
+			std::size_t size = std::min(s_rows, width - (b + i) * s_rows) * stride;
+			adler = adler32_combine(adler, adlers[i], size);
+			chunk(file, "IDAT", deflated[i].data(), deflated[i].size());
+		}
+	}
+	
+	unsigned char trailer[4];
+	store(trailer, adler);
+	chunk(file, "IDAT", trailer, sizeof(trailer));
+	chunk(file, "IEND", nullptr, 0);
+	
+	bool ok = !std::ferror(file);
+	return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "algorithm_ext.h"
+#include "clone_classes.h"
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <vector>
+
+// Renders the whole grid on the CPU, without a window: file borders, the
+// diagonal and clone density, as on screen. Bands of rows are rendered on
+// all cores and written out in order, so the image never has to fit in
+// memory.
+class Rasterizer
+{
+public:
+	typedef std::pair<std::int32_t, std::int32_t> Point;
+	typedef std::pair<Point, Point> Line;
+	
+	// Borders are the first line of every file. With a split, only pairs of
+	// a line before it and one after it are drawn, and no diagonal.
+	Rasterizer(int size, std::vector<int> borders, alg::array_view<Point> points,
+		alg::array_view<Line> lines, const CloneClasses &classes, int split)
+		: m_size(size), m_borders(std::move(borders)), m_points(points),
+		  m_lines(lines), m_classes(classes), m_split(split) {}
+	
+	// A PNG of width x width pixels, false when it could not be written.
+	bool write(const boost::filesystem::path &path, int width) const;
+	
+private:
+	static const int s_rows = 32; // Rows per band
+	static const std::size_t s_class_bins = 256; // Beyond, classes are drawn per row and column
+	
+	// Members of a class per pixel: the first one and how many.
+	struct Bin {
+		std::int32_t first;
+		std::uint32_t count;
+	};
+	
+	int m_size;
+	std::vector<int> m_borders;
+	alg::array_view<Point> m_points;
+	alg::array_view<Line> m_lines;
+	const CloneClasses &m_classes;
+	int m_split;
+};
+
+#endif // RASTERIZER_H
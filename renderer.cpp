@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+#include "renderer.h"
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <initializer_list>
+#include <stdexcept>
+
+static const char *s_common = R"(#version 330 core
+uniform vec2 u_scale;  // Lines to clip space
+uniform vec2 u_shift;  // Half a pixel, in clip space
+uniform vec2 u_offset;
+uniform vec4 u_color;
+uniform float u_zoom, u_fade, u_size;
+uniform bool u_mirror;
+out vec4 v_color;
+out vec2 v_uv;
+
+vec4 place(vec2 p)
+{
+	p += u_offset;
+	return vec4((u_mirror ? p.yx : p) * u_scale + u_shift, 0, 1);
+}
+vec4 tint(vec4 c) { return vec4(c.rgb, c.a * pow(u_zoom, u_fade)) * u_color; }
+float point_size() { return max(1., ceil(u_zoom * u_size)); }
+)";
+
+static const char *s_vertex[] = {
+	// Layout::points
+	R"(layout(location = 0) in vec2 position;
+	void main() {
+		gl_Position = place(position);
+		gl_PointSize = point_size();
+		v_color = tint(vec4(1));
+	})",
+	// Layout::colored
+	R"(layout(location = 0) in vec2 position;
+	layout(location = 1) in vec4 color;
+	void main() {
+		gl_Position = place(position);
+		gl_PointSize = point_size();
+		v_color = tint(color);
+	})",
+	// Layout::runs, see SpatialIndex::runs(). Vertex 0 and 1 are the start and end.
+	R"(layout(location = 0) in uvec2 run;
+	void main() {
+		vec2 start = vec2(run.x & 0xfffffu, run.y);
+		gl_Position = place(start + float(gl_VertexID) * float(run.x >> 20));
+		v_color = tint(vec4(1));
+	})",
+	// Layout::glyphs, quads on pixel edges are not shifted.
+	R"(layout(location = 0) in vec2 position;
+	layout(location = 1) in vec2 uv;
+	layout(location = 2) in vec4 color;
+	void main() {
+		gl_Position = place(position) - vec4(u_shift, 0, 0);
+		v_uv = uv;
+		v_color = tint(color);
+	})",
+};
+
+static const char *s_fragment = R"(#version 330 core
+in vec4 v_color;
+out vec4 color;
+void main() { color = v_color; }
+)";
+
+static const char *s_glyph_fragment = R"(#version 330 core
+uniform sampler2D u_atlas;
+in vec4 v_color;
+in vec2 v_uv;
+out vec4 color;
+void main() { color = vec4(v_color.rgb, v_color.a * texture(u_atlas, v_uv).r); }
+)";
+
+struct Program {
+	GLuint id = 0;
+	GLint scale, shift, offset, color, zoom, fade, size, mirror;
+};
+
+static Program s_programs[4];
+
+static struct {
+	float scale[2] = {1, 1}, shift[2] = {0, 0}, offset[2] = {0, 0};
+	float color[4] = {1, 1, 1, 1};
+	float zoom = 1, fade = 0, size = 1;
+	bool mirror = false;
+} s_state;
+
+static GLuint compile(GLenum type, std::initializer_list<const char *> sources)
+{
+	std::vector<const char *> text(sources);
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, text.size(), text.data(), nullptr);
+	glCompileShader(shader);
+	
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if (!ok) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		throw std::runtime_error(std::string("Shader: ") + log);
+	}
+	return shader;
+}
+
+void Renderer::setup()
+{
+	for (int i = 0; i < 4; ++i) {
+		GLuint vertex = compile(GL_VERTEX_SHADER, {s_common, s_vertex[i]});
+		GLuint fragment = compile(GL_FRAGMENT_SHADER,
+			{Layout(i) == Layout::glyphs ? s_glyph_fragment : s_fragment});
+		
+		Program &p = s_programs[i];
+		p.id = glCreateProgram();
+		glAttachShader(p.id, vertex);
+		glAttachShader(p.id, fragment);
+		glLinkProgram(p.id);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		
+		p.scale  = glGetUniformLocation(p.id, "u_scale");
+		p.shift  = glGetUniformLocation(p.id, "u_shift");
+		p.offset = glGetUniformLocation(p.id, "u_offset");
+		p.color  = glGetUniformLocation(p.id, "u_color");
+		p.zoom   = glGetUniformLocation(p.id, "u_zoom");
+		p.fade   = glGetUniformLocation(p.id, "u_fade");
+		p.size   = glGetUniformLocation(p.id, "u_size");
+		p.mirror = glGetUniformLocation(p.id, "u_mirror");
+	}
+	
+	glEnable(GL_PROGRAM_POINT_SIZE);
+}
+
+void Renderer::view(double scale, int width, int height, bool flip)
+{
+	s_state.zoom = scale;
+	s_state.scale[0] = 2 * scale / width;
+	s_state.scale[1] = (flip ? -2 : 2) * scale / height;
+	s_state.shift[0] = 1. / width;
+	s_state.shift[1] = 1. / height;
+}
+
+void Renderer::offset(double x, double y)
+{
+	s_state.offset[0] = x;
+	s_state.offset[1] = y;
+}
+
+void Renderer::color(float r, float g, float b, float a, float fade)
+{
+	s_state.color[0] = r;
+	s_state.color[1] = g;
+	s_state.color[2] = b;
+	s_state.color[3] = a;
+	s_state.fade = fade;
+}
+
+void Renderer::point_size(double size)
+{
+	s_state.size = size;
+}
+
+void Renderer::mirror(bool mirror)
+{
+	s_state.mirror = mirror;
+}
+
+void Renderer::Layer::release()
+{
+	if (!m_vao) return;
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteVertexArrays(1, &m_vao);
+	m_vao = m_vbo = 0;
+	m_capacity = 0;
+}
+
+void Renderer::Layer::bind()
+{
+	if (m_vao) {
+		glBindVertexArray(m_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		return;
+	}
+	
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	
+	glEnableVertexAttribArray(0);
+	switch (m_layout) {
+		case Layout::points:
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8, 0);
+			break;
+			
+		case Layout::colored:
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 12, 0);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12, (void *) 8);
+			break;
+			
+		case Layout::runs:
+			// Set again for every draw, see draw().
+			glVertexAttribDivisor(0, 1);
+			break;
+			
+		case Layout::glyphs:
+			glEnableVertexAttribArray(1);
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 20, 0);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (void *) 8);
+			glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, 20, (void *) 16);
+			break;
+	}
+}
+
+void Renderer::Layer::upload(const void *data, std::size_t bytes, bool stream)
+{
+	bind();
+	glBufferData(GL_ARRAY_BUFFER, bytes, data, stream ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+	m_capacity = bytes;
+}
+
+bool Renderer::Layer::reserve(std::size_t bytes)
+{
+	if (bytes <= m_capacity) return false;
+	
+	bind();
+	m_capacity = bytes + bytes / 2;
+	glBufferData(GL_ARRAY_BUFFER, m_capacity, nullptr, GL_DYNAMIC_DRAW);
+	return true;
+}
+
+void Renderer::Layer::write(std::size_t offset, const void *data, std::size_t bytes)
+{
+	bind();
+	glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+}
+
+void Renderer::Layer::draw(unsigned int mode, int first, int count) const
+{
+	draw(mode, &first, &count, 1);
+}
+
+void Renderer::Layer::draw(unsigned int mode, const int *first, const int *count, std::size_t n) const
+{
+	if (!m_vao || !n) return;
+	
+	const Program &p = s_programs[int(m_layout)];
+	glUseProgram(p.id);
+	glUniform2fv(p.scale, 1, s_state.scale);
+	glUniform2fv(p.shift, 1, s_state.shift);
+	glUniform2fv(p.offset, 1, s_state.offset);
+	glUniform4fv(p.color, 1, s_state.color);
+	glUniform1f(p.zoom, s_state.zoom);
+	glUniform1f(p.fade, s_state.fade);
+	glUniform1f(p.size, s_state.size);
+	glUniform1i(p.mirror, s_state.mirror);
+	
+	glBindVertexArray(m_vao);
+	if (m_layout != Layout::runs) {
+		glMultiDrawArrays(mode, first, count, n);
+		return;
+	}
+	
+	// Instances start at the first run of every range.
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	for (std::size_t i = 0; i < n; ++i) {
+		glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, 8, (void *) (std::size_t(first[i]) * 8));
+		glDrawArraysInstanced(mode, 0, 2, count[i]);
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Core profile rendering, with one shader program per vertex layout.
+// Positions are in lines, relative to the view. The view maps them to
+// the window, and the shaders work out point size and fading from the
+// scale.
+class Renderer
+{
+public:
+	typedef std::pair<float, float> Vertex;
+	
+	enum class Layout {
+		points,  // Float x, y
+		colored, // Float x, y and four bytes of color
+		runs,    // A run packed in two words, drawn as an instanced line
+		glyphs,  // Float x, y, u, v and four bytes of color
+	};
+	
+	// A VAO with its own buffer, created on first use. Released explicitly,
+	// as a handle it may be copied.
+	class Layer
+	{
+	public:
+		explicit Layer(Layout layout) : m_layout(layout) {}
+		void release();
+		
+		// Replaces the contents of the buffer, stream when it changes every frame.
+		void upload(const void *data, std::size_t bytes, bool stream = false);
+		template<typename T>
+		void upload(const std::vector<T> &data, bool stream = false)
+		{ upload(data.data(), data.size() * sizeof(T), stream); }
+		
+		// Grows the buffer by half when too small, true when it lost its contents.
+		bool reserve(std::size_t bytes);
+		void write(std::size_t offset, const void *data, std::size_t bytes);
+		
+		// Elements are vertices, or runs for the runs layout.
+		void draw(unsigned int mode, int first, int count) const;
+		void draw(unsigned int mode, const int *first, const int *count, std::size_t n) const;
+		
+	private:
+		void bind();
+		
+		Layout m_layout;
+		unsigned int m_vao = 0, m_vbo = 0;
+		std::size_t m_capacity = 0;
+	};
+	
+	// Compiles the programs, once there is a context.
+	static void setup();
+	
+	// What follows is drawn scaled to pixels around the window center,
+	// upside down when flipped.
+	static void view(double scale, int width, int height, bool flip = false);
+	
+	// Added to every position, to draw relative to the view.
+	static void offset(double x, double y);
+	
+	// Alpha is also multiplied by scale^fade. Per vertex colors are multiplied.
+	static void color(float r, float g, float b, float a, float fade = 0);
+	
+	// In lines, at least one pixel.
+	static void point_size(double size);
+	
+	// Swaps x and y after the offset, so one half of the grid draws the other.
+	static void mirror(bool mirror);
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sort_detector.h"
+#include "algorithm_ext.h"
+#include "corpus.h"
+#include "profiler.h"
+
+#include <parallel/algorithm>
+
+void SortDetector::detect(Corpus &corpus, Lines &lines, int runs, const Group &group)
+{
+	Profiler::Phase sort("sort windows", lines.size());
+	__gnu_parallel::sort(begin(lines), end(lines), [&] (std::uint32_t a, std::uint32_t b) {
+		return std::lexicographical_compare(corpus.key(a), corpus.key(a + runs), corpus.key(b), corpus.key(b + runs));
+	});
+	sort.end();
+	
+	// Comparing is the work, groups still come in order on this thread.
+	typedef std::vector<std::pair<Lines::iterator, Lines::iterator>> Groups;
+	Profiler::Phase phase("group windows", lines.size());
+	alg::parallel_process_adjacent<Groups>(begin(lines), end(lines),
+		[&] (std::uint32_t a, std::uint32_t b) {
+			return alg::equal(corpus.key(a), corpus.key(a + runs), corpus.key(b), corpus.key(b + runs));
+		}, [] (Groups &, Lines::iterator, Lines::iterator) {},
+		[] (Groups &groups, Lines::iterator first, Lines::iterator last) { groups.emplace_back(first, last); },
+		[&] (const Groups &groups) {
+			for (const auto &g : groups)
+				group(g.first, g.second);
+		}
+	);
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "source_filter.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+
+namespace {
+
+// Words known up front, looked up with a hash that has no collisions on
+// them, so a lookup is one hash and one compare.
+class PerfectSet
+{
+public:
+	PerfectSet(std::initializer_list<const char *> words)
+	{
+		std::size_t size = 1;
+		while (size < 2 * words.size()) size *= 2;
+		for (m_seed = 1; !place(words, size); ++m_seed)
+			if (m_seed % 64 == 0) size *= 2;
+	}
+	
+	bool contains(const char *first, const char *last) const
+	{
+		if (first == last) return false;
+		const std::string &word = m_table[slot(first, last)];
+		return word.size() == std::size_t(last - first) && std::equal(first, last, word.data());
+	}
+	
+	bool contains(const std::string &word) const
+	{ return contains(word.data(), word.data() + word.size()); }
+	
+private:
+	std::vector<std::string> m_table;
+	std::uint64_t m_seed;
+	std::size_t m_mask;
+	
+	std::size_t slot(const char *first, const char *last) const
+	{
+		std::uint64_t h = m_seed;
+		for (; first != last; ++first)
+			h = (h ^ static_cast<unsigned char>(*first)) * 0x100000001b3;
+		return (h >> 32) & m_mask;
+	}
+	
+	bool place(std::initializer_list<const char *> words, std::size_t size)
+	{
+		m_table.assign(size, std::string());
+		m_mask = size - 1;
+		for (const char *word : words) {
+			std::string &entry = m_table[slot(word, word + std::strlen(word))];
+			if (!entry.empty()) return false;
+			entry = word;
+		}
+		return true;
+	}
+};
+
+const PerfectSet s_extensions{"h", "c", "hpp", "cpp", "cc", "cs", "java", "py", "rb", "php", "hs", "sh", "y", "ll", "diff"};
+const PerfectSet s_names{"CMakeLists.txt"};
+const PerfectSet s_pruned{"build", "test", "third_party"};
+const char *s_ignore_files[] = {".gitignore", ".clonegridignore"}; // Later ones win
+
+// Wildcards as in .gitignore: * and ? stop at a slash, ** does not.
+bool glob(const char *p, const char *pe, const char *s, const char *se)
+{
+	for (; p != pe; ++p, ++s) {
+		if (*p == '*') {
+			bool any = p + 1 != pe && p[1] == '*';
+			p += any ? 2 : 1;
+			
+			// "**/" is zero or more whole directories.
+			if (any && p != pe && *p == '/')
+				for (const char *t = s; ; ++t) {
+					if (glob(p + 1, pe, t, se)) return true;
+					if ((t = std::find(t, se, '/')) == se) return false;
+				}
+			
+			for (const char *t = s; ; ++t) {
+				if (glob(p, pe, t, se)) return true;
+				if (t == se || (!any && *t == '/')) return false;
+			}
+		}
+		if (s == se) return false;
+		
+		if (*p == '?') {
+			if (*s == '/') return false;
+		} else if (*p == '[' && pe - p > 2 && std::find(p + 2, pe, ']') != pe) {
+			const char *q = p + 1;
+			bool negate = *q == '!' || *q == '^';
+			if (negate) ++q;
+			
+			// A ] right after the [ is one of the characters.
+			bool match = false;
+			for (const char *first = q; q != pe && (*q != ']' || q == first); ++q)
+				if (q + 2 < pe && q[1] == '-' && q[2] != ']') {
+					match |= *s >= q[0] && *s <= q[2];
+					q += 2;
+				} else
+					match |= *q == *s;
+			if (q == pe || match == negate || *s == '/') return false;
+			p = q;
+		} else {
+			if (*p == '\\' && p + 1 != pe) ++p;
+			if (*p != *s) return false;
+		}
+	}
+	return s == se;
+}
+
+}
+
+bool SourceFilter::parse(std::string line, Rule &rule)
+{
+	while (!line.empty() && std::strchr(" \t\r", line.back()) && !(line.size() > 1 && line[line.size() - 2] == '\\'))
+		line.pop_back();
+	if (line.empty() || line[0] == '#') return false;
+	
+	rule.negate = line[0] == '!';
+	if (rule.negate || (line[0] == '\\' && line.size() > 1 && std::strchr("#!", line[1]))) line.erase(0, 1);
+	rule.directory = !line.empty() && line.back() == '/';
+	if (rule.directory) line.pop_back();
+	rule.anchored = line.find('/') != std::string::npos;
+	if (!line.empty() && line[0] == '/') line.erase(0, 1);
+	if (line.empty()) return false;
+	
+	// Most rules are a name or an extension, those skip the wildcards.
+	const char *wild = "*?[\\";
+	if (line.find_first_of(wild) == std::string::npos)
+		rule.kind = Rule::Kind::literal;
+	else if (!rule.anchored && line[0] == '*' && line.find_first_of(wild, 1) == std::string::npos) {
+		rule.kind = Rule::Kind::suffix;
+		line.erase(0, 1);
+	} else
+		rule.kind = Rule::Kind::glob;
+	rule.pattern = line;
+	return true;
+}
+
+void SourceFilter::add_rule(const std::string &rule)
+{
+	Rule r;
+	if (parse(rule, r)) m_rules.push_back(r);
+}
+
+void SourceFilter::read(const std::string &path, std::vector<Rule> &rules)
+{
+	std::ifstream in(path);
+	Rule rule;
+	for (std::string line; std::getline(in, line); )
+		if (parse(line, rule)) rules.push_back(rule);
+}
+
+bool SourceFilter::matches(const Rule &rule, const std::string &path, const std::string &name, bool directory)
+{
+	if (rule.directory && !directory) return false;
+	const std::string &s = rule.anchored ? path : name;
+	
+	switch (rule.kind) {
+		case Rule::Kind::literal:
+			return s == rule.pattern;
+		case Rule::Kind::suffix:
+			return s.size() >= rule.pattern.size() && s.compare(s.size() - rule.pattern.size(), std::string::npos, rule.pattern) == 0;
+		case Rule::Kind::glob:
+			return glob(rule.pattern.data(), rule.pattern.data() + rule.pattern.size(), s.data(), s.data() + s.size());
+	}
+	return false;
+}
+
+// The last rule that matches decides, command line rules first, then the
+// ignore files from the deepest up. Without one, the built in rules do.
+bool SourceFilter::ignored(const Frame &frame, const std::string &path, const std::string &name, bool directory) const
+{
+	for (auto rule = m_rules.rbegin(); rule != m_rules.rend(); ++rule)
+		if (matches(*rule, path, name, directory)) return !rule->negate;
+	
+	for (const Frame *f = &frame; f; f = f->parent) {
+		std::string below = f->base.empty() ? path : path.substr(f->base.size() + 1);
+		for (auto rule = f->rules.rbegin(); rule != f->rules.rend(); ++rule)
+			if (matches(*rule, below, name, directory)) return !rule->negate;
+	}
+	
+	return name[0] == '.' || s_pruned.contains(name);
+}
+
+std::vector<std::string> SourceFilter::walk(const std::string &root) const
+{
+	std::vector<std::string> files;
+	#pragma omp parallel
+	#pragma omp single
+	visit(root, "", nullptr, files);
+	return files;
+}
+
+// Lists the directory, then visits its subdirectories as tasks. Their files
+// are put in place once all are done, so the order stays that of readdir().
+void SourceFilter::visit(const std::string &path, const std::string &relative, const Frame *parent, std::vector<std::string> &files) const
+{
+	DIR *dir = opendir(path.c_str());
+	if (!dir) {
+		std::string error = std::strerror(errno);
+		#pragma omp critical(source_filter_error)
+		std::cerr << "Could not read " << path << ": " << error << "\n";
+		return;
+	}
+	
+	std::vector<std::pair<std::string, unsigned char>> entries;
+	while (dirent *entry = readdir(dir))
+		if (std::strcmp(entry->d_name, ".") && std::strcmp(entry->d_name, ".."))
+			entries.emplace_back(entry->d_name, entry->d_type);
+	closedir(dir);
+	
+	Frame frame{parent, relative, {}};
+	std::string prefix = path.empty() || path.back() == '/' ? path : path + "/";
+	for (const char *name : s_ignore_files)
+		if (std::any_of(begin(entries), end(entries), [&] (const std::pair<std::string, unsigned char> &e) { return e.first == name; }))
+			read(prefix + name, frame.rules);
+	
+	// Symbolic links are neither followed nor read.
+	std::size_t directories = 0;
+	for (auto &entry : entries) {
+		if (entry.second == DT_UNKNOWN) {
+			struct stat st;
+			if (lstat((prefix + entry.first).c_str(), &st) != 0) entry.second = DT_UNKNOWN;
+			else entry.second = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+		}
+		
+		bool directory = entry.second == DT_DIR;
+		std::string below = relative.empty() ? entry.first : relative + "/" + entry.first;
+		if ((!directory && entry.second != DT_REG) || ignored(frame, below, entry.first, directory)) {
+			entry.second = DT_UNKNOWN;
+			continue;
+		}
+		if (directory) {
+			directories++;
+			continue;
+		}
+		
+		const char *dot = std::strrchr(entry.first.c_str(), '.');
+		if (!s_names.contains(entry.first) && !(dot && s_extensions.contains(dot + 1, entry.first.c_str() + entry.first.size())))
+			entry.second = DT_UNKNOWN;
+	}
+	
+	std::vector<std::vector<std::string>> below(directories);
+	std::size_t next = 0;
+	for (const auto &entry : entries)
+		if (entry.second == DT_DIR) {
+			std::vector<std::string> *result = &below[next++];
+			std::string child = prefix + entry.first;
+			std::string child_relative = relative.empty() ? entry.first : relative + "/" + entry.first;
+			#pragma omp task shared(frame) firstprivate(result, child, child_relative)
+			visit(child, child_relative, &frame, *result);
+		}
+	#pragma omp taskwait
+	
+	next = 0;
+	for (const auto &entry : entries)
+		if (entry.second == DT_REG)
+			files.push_back(prefix + entry.first);
+		else if (entry.second == DT_DIR) {
+			std::vector<std::string> &result = below[next++];
+			files.insert(end(files), std::make_move_iterator(begin(result)), std::make_move_iterator(end(result)));
+		}
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOURCE_FILTER_H
+#define SOURCE_FILTER_H
+
+#include <string>
+#include <vector>
+
+// Decides which files read_source() reads: those with a known extension,
+// outside build, test, third party and hidden directories, and not ignored
+// by a rule. Rules have the syntax of .gitignore and come from the command
+// line, and from every .gitignore and .clonegridignore on the way down.
+class SourceFilter
+{
+public:
+	// Relative to the walked directory, before any ignore file.
+	void add_rule(const std::string &rule);
+	
+	// The files below root that pass, found on all cores but in the order
+	// of a plain recursive walk. Directories that can't be read are skipped.
+	std::vector<std::string> walk(const std::string &root) const;
+	
+private:
+	struct Rule {
+		enum class Kind { literal, suffix, glob };
+		
+		std::string pattern; // Without !, the leading / and the trailing /
+		Kind kind;
+		bool negate;
+		bool directory;      // Only matches directories
+		bool anchored;       // Matches the path below the rule's directory, not the name
+	};
+	
+	// The rules of one directory, and those of the directories above it.
+	struct Frame {
+		const Frame *parent;
+		std::string base; // Relative to the root
+		std::vector<Rule> rules;
+	};
+	
+	std::vector<Rule> m_rules;
+	
+	static bool parse(std::string line, Rule &rule);
+	static void read(const std::string &path, std::vector<Rule> &rules);
+	static bool matches(const Rule &rule, const std::string &path, const std::string &name, bool directory);
+	bool ignored(const Frame &frame, const std::string &path, const std::string &name, bool directory) const;
+	void visit(const std::string &path, const std::string &relative, const Frame *parent, std::vector<std::string> &files) const;
+};
+
+#endif // SOURCE_FILTER_H
@@ -26,29 +26,20 @@
 #include "sourcefile.h"
 
 #include <boost/format.hpp>
-#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
 
-namespace fs = boost::filesystem;
-
-std::size_t SourceFile::read()
+bool SourceFile::stat()
 {
-	std::size_t size = fs::file_size(m_path);
-	std::ifstream ifs(m_path.string());
-	std::istreambuf_iterator<char> first(ifs), last;
-	m_data.reserve(size);
-	m_data.assign(first, last);
-	
-	auto it = begin(m_data);
-	m_index.push_back(it);
-	while ((it = std::find(it, end(m_data), '\n')) != end(m_data))
-		m_index.push_back(++it);
-	
-	m_index.push_back(end(m_data));
+	struct stat st;
+	if (::stat(m_path.c_str(), &st) != 0) return false;
 	
-	return size;
+	m_mtime = std::int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	m_bytes = st.st_size;
+	return true;
 }
 
 std::ostream &operator<<(std::ostream &out, const SourceFile &file)
 {
-	return out << boost::format("%5d: %s\n") % file.line_count() % file.m_name;
+	return out << boost::format("%5d: %s\n") % file.line_count() % file.name();
 }
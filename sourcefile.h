@@ -27,34 +27,37 @@
 #define SOURCEFILE_H
 
 #include <boost/filesystem.hpp>
+#include <cstdint>
 
+// What lines are compared on, see normalize_text() in corpus.cpp.
+enum class Normalize {
+	none,
+	whitespace,
+	tokens,
+};
+
+// A file on disk, its text is kept in the Corpus.
 struct SourceFile {
-	SourceFile(const boost::filesystem::path &path, const std::string &name, int position)
-		: m_path(path), m_name(name), m_position(position) {}
+	SourceFile(const boost::filesystem::path &path, std::size_t root, int position = 0)
+		: m_path(path), m_root(root), m_position(position) {}
 	
-	std::size_t read();
-	std::size_t line_count() const { return m_index.size() - 1; }
-	std::string::const_iterator line(int i) const { return m_index[i]; }
+	// Thread safe, returns false when the file is gone.
+	bool stat();
+	std::size_t line_count() const { return m_count; }
 	
-	std::vector<std::string::const_iterator> m_index;
-	std::string m_data;
+	// The path below the directory that was read.
+	const char *name() const { return m_path.c_str() + m_root; }
+	
+	std::vector<std::uint64_t> m_hashes; // Line hashes known up front, from the cache
 	boost::filesystem::path m_path;
-	std::string m_name;
+	std::size_t m_root;
 	int m_position;
+	int m_tree = 0;            // Index of the path it was read from
+	std::size_t m_count = 0;   // Lines, also known before reading when cached
+	std::int64_t m_mtime = 0;  // Nanoseconds, as seen by stat()
+	std::uint64_t m_bytes = 0;
 	
 	friend std::ostream &operator<<(std::ostream &out, const SourceFile &file);
 };
 
-struct SourceLine {
-	SourceLine(SourceFile *file, int number)
-		: m_file(file), m_number(number) {}
-	
-	int position() const { return m_file->m_position + m_number; }
-	std::string::const_iterator operator[](int i) const
-	{ return m_file->line(m_number + i); }
-	
-	SourceFile *m_file;
-	int m_number;
-};
-
 #endif // SOURCEFILE_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spatial_index.h"
+
+#include <cmath>
+#include <parallel/algorithm>
+
+void SpatialIndex::arrange(std::vector<Point> &points, std::vector<Line> &lines)
+{
+	const int size = 1 << s_shift;
+	
+	// A piece ends on the first point of the next tile, so pieces still join.
+	std::vector<Line> pieces;
+	pieces.reserve(lines.size());
+	for (const Line &line : lines) {
+		Point a = line.first;
+		for (int n = line.second.first - a.first; n > 0; ) {
+			int x = a.first, y = a.second;
+			int m = std::min({n, size - (x & (size - 1)), size - (y & (size - 1))});
+			Point b(x + m, y + m);
+			pieces.emplace_back(a, b);
+			a = b; n -= m;
+		}
+	}
+	lines.swap(pieces);
+	
+	__gnu_parallel::sort(begin(points), end(points), [] (const Point &a, const Point &b) {
+		std::uint64_t ka = key(a), kb = key(b);
+		return ka < kb || (ka == kb && a < b);
+	});
+	__gnu_parallel::sort(begin(lines), end(lines), [] (const Line &a, const Line &b) {
+		std::uint64_t ka = key(a.first), kb = key(b.first);
+		return ka < kb || (ka == kb && a < b);
+	});
+}
+
+std::vector<SpatialIndex::Vertex> SpatialIndex::vertices(alg::array_view<Point> points)
+{
+	std::vector<Vertex> vertices;
+	vertices.reserve(points.size());
+	for (const Point &p : points) {
+		Point o = origin(p);
+		vertices.emplace_back(p.first - o.first, p.second - o.second);
+	}
+	return vertices;
+}
+
+std::vector<SpatialIndex::Run> SpatialIndex::runs(alg::array_view<Line> lines)
+{
+	std::vector<Run> runs;
+	runs.reserve(lines.size());
+	for (const Line &l : lines) {
+		Point o = origin(l.first);
+		std::uint32_t length = l.second.first - l.first.first;
+		runs.emplace_back((l.first.first - o.first) | length << s_block, l.first.second - o.second);
+	}
+	return runs;
+}
+
+template<typename T, typename Key>
+void SpatialIndex::tiles(alg::array_view<T> elements, Key key, std::vector<Tile> &tiles)
+{
+	tiles.clear();
+	for (std::size_t i = 0; i < elements.size(); ++i)
+		if (tiles.empty() || tiles.back().key != key(elements[i]))
+			tiles.push_back(Tile{key(elements[i]), i});
+	
+	tiles.push_back(Tile{~std::uint64_t(0), elements.size()});
+}
+
+void SpatialIndex::build(alg::array_view<Point> points, alg::array_view<Line> lines)
+{
+	tiles(points, [] (const Point &p) { return key(p); }, m_points);
+	tiles(lines, [] (const Line &l) { return key(l.first); }, m_lines);
+}
+
+void SpatialIndex::query(const std::vector<Tile> &tiles,
+	double x0, double y0, double x1, double y1,
+	std::vector<int> &first, std::vector<int> &count, std::vector<Batch> &batches)
+{
+	first.clear();
+	count.clear();
+	batches.clear();
+	if (tiles.size() < 2) return;
+	
+	// Lines reach one line into the next tile.
+	std::uint32_t tx0 = std::max(0., std::floor(x0 - 1)) / (1 << s_shift);
+	std::uint32_t ty0 = std::max(0., std::floor(y0 - 1)) / (1 << s_shift);
+	std::uint32_t tx1 = std::max(0., std::ceil (x1 + 1)) / (1 << s_shift);
+	std::uint32_t ty1 = std::max(0., std::ceil (y1 + 1)) / (1 << s_shift);
+	
+	const int b = s_block - s_shift;
+	auto less = [] (const Tile &t, std::uint64_t key) { return t.key < key; };
+	auto last = end(tiles) - 1;
+	for (std::uint64_t bx = tx0 >> b; bx <= tx1 >> b; ++bx)
+	for (std::uint64_t by = ty0 >> b; by <= ty1 >> b; ++by) {
+		std::size_t start = first.size();
+		std::uint64_t c0 = std::max<std::uint64_t>(tx0, bx << b), c1 = std::min<std::uint64_t>(tx1, ((bx + 1) << b) - 1);
+		std::uint64_t r0 = std::max<std::uint64_t>(ty0, by << b), r1 = std::min<std::uint64_t>(ty1, ((by + 1) << b) - 1);
+		
+		for (std::uint64_t tx = c0; tx <= c1; ++tx) {
+			auto a = std::lower_bound(begin(tiles), last, key(tx, r0), less);
+			auto e = std::lower_bound(a, last, key(tx, r1) + 1, less);
+			if (a == e) continue;
+			
+			// Adjacent ranges of the block are joined into one.
+			int f = a->first, c = e->first - a->first;
+			if (first.size() > start && first.back() + count.back() == f)
+				count.back() += c;
+			else {
+				first.push_back(f);
+				count.push_back(c);
+			}
+		}
+		
+		if (first.size() > start)
+			batches.push_back(Batch{Point(bx << s_block, by << s_block), first.size()});
+	}
+}
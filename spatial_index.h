@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "algorithm_ext.h"
+#include <cstdint>
+#include <vector>
+
+// Tiles of 256 x 256 lines over clone points and lines, grouped in blocks
+// of 2^20 x 2^20 lines. Both are kept sorted by block and tile, so every
+// tile is one contiguous range. Vertices are uploaded relative to the origin
+// of their block, floats then stay exact however large the grid gets.
+class SpatialIndex
+{
+public:
+	typedef std::pair<std::int32_t, std::int32_t> Point;
+	typedef std::pair<Point, Point> Line;
+	typedef std::pair<float, float> Vertex;
+	typedef std::pair<std::uint32_t, std::uint32_t> Run;
+	
+	// The ranges of one block, up to end in first and count.
+	struct Batch {
+		Point origin;
+		std::size_t end;
+	};
+	
+	static Point origin(const Point &p)
+	{ return Point(p.first >> s_block << s_block, p.second >> s_block << s_block); }
+	
+	// Cuts lines at tile borders and sorts both by block and tile.
+	static void arrange(std::vector<Point> &points, std::vector<Line> &lines);
+	
+	// Relative to the origin of their block.
+	static std::vector<Vertex> vertices(alg::array_view<Point> points);
+	
+	// Lines as runs relative to the origin of their block: x with the length
+	// from bit 20, and y. Arranged lines stay within a tile, so they fit.
+	static std::vector<Run> runs(alg::array_view<Line> lines);
+	
+	// Expects arranged points and lines.
+	void build(alg::array_view<Point> points, alg::array_view<Line> lines);
+	
+	// Ranges of points or lines, in elements, that may lie in the box.
+	void points(double x0, double y0, double x1, double y1,
+		std::vector<int> &first, std::vector<int> &count, std::vector<Batch> &batches) const
+	{ query(m_points, x0, y0, x1, y1, first, count, batches); }
+	void lines(double x0, double y0, double x1, double y1,
+		std::vector<int> &first, std::vector<int> &count, std::vector<Batch> &batches) const
+	{ query(m_lines, x0, y0, x1, y1, first, count, batches); }
+	
+private:
+	static const int s_shift = 8;
+	static const int s_block = 20;
+	static const std::uint32_t s_mask = (1 << (s_block - s_shift)) - 1;
+	
+	// Key of every non-empty tile and its first element, with a sentinel.
+	struct Tile {
+		std::uint64_t key;
+		std::size_t first;
+	};
+	
+	std::vector<Tile> m_points, m_lines;
+	
+	// Block, then tile within the block, from tile coordinates.
+	static std::uint64_t key(std::uint64_t tx, std::uint64_t ty)
+	{
+		const int b = s_block - s_shift;
+		return (tx >> b) << 48 | (ty >> b) << 32 | (tx & s_mask) << 16 | (ty & s_mask);
+	}
+	static std::uint64_t key(const Point &p)
+	{ return key(std::uint32_t(p.first) >> s_shift, std::uint32_t(p.second) >> s_shift); }
+	
+	template<typename T, typename Key>
+	static void tiles(alg::array_view<T> elements, Key key, std::vector<Tile> &tiles);
+	
+	static void query(const std::vector<Tile> &tiles,
+		double x0, double y0, double x1, double y1,
+		std::vector<int> &first, std::vector<int> &count, std::vector<Batch> &batches);
+};
+
+#endif // SPATIAL_INDEX_H
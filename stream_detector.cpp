@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stream_detector.h"
+#include "corpus.h"
+#include "profiler.h"
+
+std::size_t StreamDetector::read(const Files &files, Normalize normalize, int runs)
+{
+	Profiler::Phase phase("hash files", files.size());
+	
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (std::size_t i = 0; i < files.size(); ++i)
+		files[i]->stat();
+	
+	// Batches of files are hashed in parallel, their windows then go out in
+	// order. A file takes about three times its size while it is hashed.
+	std::size_t position = 0;
+	std::vector<std::vector<std::uint64_t>> windows;
+	for (std::size_t first = 0, last; first < files.size(); first = last) {
+		std::uint64_t bytes = files[first]->m_bytes;
+		for (last = first + 1; last < files.size() && 3 * (bytes + files[last]->m_bytes) <= m_budget / 2; ++last)
+			bytes += files[last]->m_bytes;
+		
+		windows.assign(last - first, std::vector<std::uint64_t>());
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (std::size_t i = first; i < last; ++i)
+			windows[i - first] = Corpus::hash_file(*files[i], normalize, runs);
+		
+		for (std::size_t i = first; i < last; ++i) {
+			files[i]->m_position = position;
+			const std::vector<std::uint64_t> &w = windows[i - first];
+			for (std::size_t k = 0; k < w.size(); ++k)
+				m_windows.push(Window{w[k], std::uint32_t(position + k)});
+			position += files[i]->line_count();
+		}
+	}
+	
+	return position;
+}
+
+bool StreamDetector::detect(const Group &group)
+{
+	Profiler::Phase phase("merge windows", m_windows.size());
+	Lines lines;
+	auto flush = [&] {
+		if (lines.size() >= 2) group(begin(lines), end(lines) - 1);
+		lines.clear();
+	};
+	
+	std::uint64_t hash = 0;
+	bool ok = m_windows.merge([&] (const Window &w) {
+		if (!lines.empty() && w.hash != hash) flush();
+		hash = w.hash;
+		lines.push_back(w.line);
+	});
+	flush();
+	return ok;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STREAM_DETECTOR_H
+#define STREAM_DETECTOR_H
+
+#include "external_sort.h"
+#include "idetector.h"
+#include "sourcefile.h"
+
+// Finds groups of identical windows without the corpus in memory. Files
+// are read and hashed a batch at a time and their text dropped, then the
+// hash and line of every window are sorted on disk. With no text left to
+// compare, windows are grouped on their hash alone.
+class StreamDetector
+{
+public:
+	typedef IDetector::Lines Lines;
+	typedef IDetector::Group Group;
+	typedef std::vector<SourceFile *> Files;
+	
+	// Buffers take up to about budget bytes.
+	explicit StreamDetector(std::size_t budget) : m_budget(budget), m_windows(budget) {}
+	
+	// Sets the positions, line counts and sizes of all files, returns the
+	// number of lines.
+	std::size_t read(const Files &files, Normalize normalize, int runs);
+	
+	// Calls group for every group of windows with the same hash, in hash
+	// order. Returns false when the temporary file failed.
+	bool detect(const Group &group);
+	
+private:
+	struct Window {
+		std::uint64_t hash;
+		std::uint32_t line;
+		
+		bool operator<(const Window &w) const
+		{ return hash < w.hash || (hash == w.hash && line < w.line); }
+	};
+	
+	std::size_t m_budget;
+	ExternalSort<Window> m_windows;
+};
+
+#endif // STREAM_DETECTOR_H
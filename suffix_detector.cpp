@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "suffix_detector.h"
+#include "algorithm_ext.h"
+#include "corpus.h"
+#include "profiler.h"
+
+#include <parallel/algorithm>
+
+namespace {
+
+typedef std::int32_t Index;
+
+struct Line {
+	std::uint64_t hash;
+	std::uint32_t line;
+	
+	bool operator<(const Line &l) const
+	{ return hash < l.hash || (hash == l.hash && line < l.line); }
+};
+
+// Heads, or tails, of the bucket of every symbol in sa.
+void buckets(const Index *text, Index n, Index k, std::vector<Index> &bucket, bool tails)
+{
+	std::fill(begin(bucket), end(bucket), 0);
+	for (Index i = 0; i < n; ++i)
+		bucket[text[i]]++;
+	for (Index c = 0, sum = 0; c < k; ++c) {
+		sum += bucket[c];
+		bucket[c] = tails ? sum : sum - bucket[c];
+	}
+}
+
+// Sorts the L-type suffixes from the sorted LMS ones, then the S-type.
+void induce(const Index *text, Index *sa, Index n, Index k, const std::vector<bool> &stype, std::vector<Index> &bucket)
+{
+	buckets(text, n, k, bucket, false);
+	for (Index i = 0; i < n; ++i)
+		if (sa[i] > 0 && !stype[sa[i] - 1])
+			sa[bucket[text[sa[i] - 1]]++] = sa[i] - 1;
+	
+	buckets(text, n, k, bucket, true);
+	for (Index i = n; i-- > 0; )
+		if (sa[i] > 0 && stype[sa[i] - 1])
+			sa[--bucket[text[sa[i] - 1]]] = sa[i] - 1;
+}
+
+// SA-IS by Nong, Zhang and Chan: the suffix array of text, in linear time.
+// Symbols are below k, the last one is a unique 0.
+void suffix_array(const Index *text, Index *sa, Index n, Index k)
+{
+	if (n == 1) { // Just the end, of an empty corpus
+		sa[0] = 0;
+		return;
+	}
+	
+	std::vector<bool> stype(n);
+	stype[n - 1] = true;
+	for (Index i = n - 1; i-- > 0; )
+		stype[i] = text[i] < text[i + 1] || (text[i] == text[i + 1] && stype[i + 1]);
+	auto lms = [&] (Index i) { return i > 0 && stype[i] && !stype[i - 1]; };
+	
+	// Sort the LMS substrings, by inducing from them in text order.
+	std::vector<Index> bucket(k);
+	buckets(text, n, k, bucket, true);
+	std::fill(sa, sa + n, -1);
+	for (Index i = 1; i < n; ++i)
+		if (lms(i)) sa[--bucket[text[i]]] = i;
+	induce(text, sa, n, k, stype, bucket);
+	
+	// Name them, equal substrings get the same name. LMS positions are at
+	// least two apart, so the names fit behind the m sorted ones.
+	Index m = 0;
+	for (Index i = 0; i < n; ++i)
+		if (lms(sa[i])) sa[m++] = sa[i];
+	std::fill(sa + m, sa + n, -1);
+	
+	Index names = 0;
+	for (Index i = 0, previous = -1; i < m; ++i) {
+		Index p = sa[i];
+		bool differ = previous < 0;
+		for (Index d = 0; !differ; ++d) {
+			if (text[p + d] != text[previous + d] || stype[p + d] != stype[previous + d])
+				differ = true;
+			else if (d > 0 && lms(p + d))
+				break;
+		}
+		if (differ) {
+			names++;
+			previous = p;
+		}
+		sa[m + p / 2] = names - 1;
+	}
+	for (Index i = n - 1, j = n - 1; i >= m; --i)
+		if (sa[i] >= 0) sa[j--] = sa[i];
+	
+	// Sort the LMS suffixes, recursively when names repeat.
+	Index *reduced = sa + n - m;
+	if (names < m)
+		suffix_array(reduced, sa, m, names);
+	else
+		for (Index i = 0; i < m; ++i)
+			sa[reduced[i]] = i;
+	
+	for (Index i = 1, j = 0; i < n; ++i)
+		if (lms(i)) reduced[j++] = i;
+	for (Index i = 0; i < m; ++i)
+		sa[i] = reduced[sa[i]];
+	std::fill(sa + m, sa + n, -1);
+	
+	buckets(text, n, k, bucket, true);
+	for (Index i = m; i-- > 0; ) {
+		Index p = sa[i];
+		sa[i] = -1;
+		sa[--bucket[text[p]]] = p;
+	}
+	induce(text, sa, n, k, stype, bucket);
+}
+
+// Calls group for every group of identical windows, and numbers the windows
+// of groups smaller than pairs in small, the others are -1.
+void find_groups(Corpus &corpus, IDetector::Lines &lines, int runs, int pairs,
+	const IDetector::Group &group, std::vector<Index> &small)
+{
+	corpus.hash(runs);
+	Index n = corpus.size() + 1;
+	
+	// Lines get ids from 1 in hash order, equal hashes are split up by their
+	// text. A 0 ends the text.
+	Profiler::Phase intern("intern lines", n - 1);
+	std::vector<Line> order(n - 1);
+	#pragma omp parallel for
+	for (Index i = 0; i < n - 1; ++i)
+		order[i] = Line{corpus.line_hash(i), std::uint32_t(i)};
+	__gnu_parallel::sort(begin(order), end(order));
+	
+	std::vector<Index> text(n, 0);
+	std::vector<std::uint32_t> texts; // First line of every text with the same hash
+	Index ids = 1;
+	for (std::size_t i = 0, j; i < order.size(); i = j) {
+		texts.clear();
+		for (j = i; j < order.size() && order[j].hash == order[i].hash; ++j) {
+			std::uint32_t l = order[j].line;
+			auto same = std::find_if(begin(texts), end(texts), [&] (std::uint32_t t) {
+				return alg::equal(corpus.key(t), corpus.key(t + 1), corpus.key(l), corpus.key(l + 1));
+			});
+			if (same == end(texts))
+				same = texts.insert(same, l);
+			text[l] = ids + (same - begin(texts));
+		}
+		ids += texts.size();
+	}
+	std::vector<Line>().swap(order);
+	intern.end();
+	
+	Profiler::Phase build("suffix array", n);
+	std::vector<Index> sa(n);
+	suffix_array(text.data(), sa.data(), n, ids);
+	
+	// Kasai et al: lcp[r] is the common prefix of the suffixes at r - 1 and r.
+	std::vector<Index> rank(n), lcp(n);
+	for (Index r = 0; r < n; ++r)
+		rank[sa[r]] = r;
+	for (Index i = 0, h = 0; i < n; ++i) {
+		if (rank[i] == 0) continue;
+		for (Index j = sa[rank[i] - 1]; text[i + h] == text[j + h]; ++h);
+		lcp[rank[i]] = h;
+		h = std::max(h - 1, 0);
+	}
+	std::vector<Index>().swap(rank);
+	std::vector<Index>().swap(text);
+	build.end();
+	
+	// Windows starting with the same runs lines are adjacent in sa, those
+	// that cross the end of a file are left out.
+	Profiler::Phase phase("group windows", lines.size());
+	std::vector<bool> window(n);
+	for (std::uint32_t l : lines)
+		window[l] = true;
+	
+	lines.clear();
+	small.assign(n, -1);
+	Index groups = 0;
+	for (Index i = 0, j; i < n; i = j) {
+		std::size_t first = lines.size();
+		for (j = i; j < n && (j == i || lcp[j] >= runs); ++j)
+			if (window[sa[j]]) lines.push_back(sa[j]);
+		
+		std::size_t size = lines.size() - first;
+		if (size < 2) {
+			lines.resize(first);
+			continue;
+		}
+		group(begin(lines) + first, end(lines) - 1);
+		if (size < std::size_t(pairs))
+			for (std::size_t k = first; k < lines.size(); ++k)
+				small[lines[k]] = groups;
+		groups += size < std::size_t(pairs);
+	}
+}
+
+}
+
+void SuffixDetector::detect(Corpus &corpus, Lines &lines, int runs, const Group &group)
+{
+	std::vector<Index> small;
+	find_groups(corpus, lines, runs, 0, group, small);
+}
+
+bool SuffixDetector::detect_runs(Corpus &corpus, Lines &lines, int runs, int pairs, const Group &group, const Run &run)
+{
+	std::vector<Index> small;
+	find_groups(corpus, lines, runs, pairs, group, small);
+	
+	// A pair starts a run when the windows before it are not a pair, the run
+	// goes on while the windows are. Every pair is visited once, and groups
+	// are small, so this is linear too.
+	Profiler::Phase phase("maximal runs", lines.size());
+	auto paired = [&] (std::uint32_t a, std::uint32_t b) { return small[a] >= 0 && small[a] == small[b]; };
+	for (std::size_t i = 0, j; i < lines.size(); i = j) {
+		for (j = i + 1; j < lines.size() && small[lines[j]] == small[lines[i]]; ++j);
+		if (small[lines[i]] < 0) continue;
+		
+		for (std::size_t i1 = i; i1 < j; ++i1)
+		for (std::size_t i2 = i; i2 < j; ++i2) {
+			std::uint32_t a = lines[i1], b = lines[i2], length = 1;
+			if (a >= b || (a > 0 && paired(a - 1, b - 1))) continue;
+			while (paired(a + length, b + length)) length++;
+			run(a, b, length);
+		}
+	}
+	return true;
+}
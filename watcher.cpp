@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013, Jasper Ruoff <jruoff@gmail.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "watcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+Watcher::Watcher() : m_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if (m_fd < 0)
+		std::cerr << "Could not watch files: " << std::strerror(errno) << "\n";
+}
+
+Watcher::~Watcher()
+{
+	if (m_fd >= 0) ::close(m_fd);
+}
+
+bool Watcher::add(const fs::path &directory)
+{
+	if (m_fd < 0) return false;
+	
+	int wd = ::inotify_add_watch(m_fd, directory.c_str(),
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM
+	);
+	if (wd < 0) {
+		std::cerr << directory.string() << ": " << std::strerror(errno) << "\n";
+		return false;
+	}
+	
+	m_directories[wd] = directory;
+	return true;
+}
+
+std::vector<fs::path> Watcher::poll()
+{
+	std::vector<fs::path> paths;
+	if (m_fd < 0) return paths;
+	
+	alignas(inotify_event) char buffer[64 * 1024];
+	ssize_t n;
+	while ((n = ::read(m_fd, buffer, sizeof(buffer))) > 0)
+		for (char *it = buffer; it < buffer + n; ) {
+			const inotify_event &event = *reinterpret_cast<inotify_event *>(it);
+			auto dir = m_directories.find(event.wd);
+			if (dir != m_directories.end() && event.len)
+				paths.push_back(dir->second / event.name);
+			it += sizeof(inotify_event) + event.len;
+		}
+	
+	std::sort(begin(paths), end(paths));
+	paths.erase(std::unique(begin(paths), end(paths)), end(paths));
+	return paths;
+}